@@ -3,49 +3,94 @@
 
 #include <SFML/Graphics.hpp>
 #include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 
 #define TEXTURES_PATH "../assets/textures/"
 #define FONTS_PATH "../assets/fonts/"
+#define BUNDLE_PATH "../assets/textures.bundle"
 
 namespace assets {
     using namespace sf;
+
+    /**
+     * \brief Every texture is packed into this one texture, so sprites
+     * drawn one after another do not need to switch textures
+    */
+    Texture atlas;
+
+    /**
+     * \brief A texture packed into `assets::atlas`
+    */
+    struct Region {
+        IntRect rect;
+        /**
+         * \return The size of the texture in pixels
+        */
+        Vector2u size() const {return Vector2u(rect.width, rect.height);}
+        /**
+         * \brief Make a sprite show this texture
+         * \param sprite_ Sprite to change
+        */
+        void apply(Sprite& sprite_) const {
+            sprite_.setTexture(atlas);
+            sprite_.setTextureRect(rect);
+        }
+        /**
+         * \param part_ Area within this texture
+         * \return A sprite showing part of this texture
+        */
+        Sprite sprite(IntRect part_) const {
+            return Sprite(atlas, IntRect(rect.left + part_.left, rect.top + part_.top, part_.width, part_.height));
+        }
+        /**
+         * \return A sprite showing this texture
+        */
+        Sprite sprite() const {return Sprite(atlas, rect);}
+    };
+
     namespace textures {
         namespace bot {
-            Texture body;
-            Texture sonar;
+            Region body;
+            Region sonar;
         }
         namespace stage {
-            Texture spawnpoint;
+            Region spawnpoint;
             namespace evaluation {
-                Texture possible;
-                Texture impossible;
+                Region possible;
+                Region impossible;
             }
         }
         namespace gui {
             namespace tick_box {
-                Texture checked;
-                Texture unchecked;
+                Region checked;
+                Region unchecked;
             }
             namespace slider {
-                Texture left;
-                Texture centre;
-                Texture right;
-                Texture handle;
+                Region left;
+                Region centre;
+                Region right;
+                Region handle;
             }
             namespace button {
-                Texture pushed;
-                Texture neutral;
+                Region pushed;
+                Region neutral;
             }
             namespace text_box {
-                Texture left;
-                Texture centre;
-                Texture right;
+                Region left;
+                Region centre;
+                Region right;
             }
             namespace progress_bar {
-                Texture empty;
-                Texture filled;
-                Texture success;
-                Texture failed;
+                Region empty;
+                Region filled;
+                Region success;
+                Region failed;
             }
         }
     }
@@ -54,49 +99,223 @@ namespace assets {
         Font arial;
     }
 
-    void load_assets() {
-
-        std::cout << "Loading Assets...\n";
-
-        bool success = true;
-        success = success and textures::bot::body.loadFromFile(TEXTURES_PATH "bot/body.png");
-        success = success and textures::bot::sonar.loadFromFile(TEXTURES_PATH "bot/sonar.png");
-
-
-        success = success and textures::stage::spawnpoint.loadFromFile(TEXTURES_PATH "stage/spawnpoint.png");
+    /**
+     * \brief A texture file and the region it is packed into
+    */
+    struct Entry {
+        const char* path; // Relative to `TEXTURES_PATH`
+        Region* region;
+    };
+    /**
+     * \return Every texture that is loaded, in bundle order
+    */
+    std::vector<Entry> entries() {
+        using namespace textures;
+        return {
+            {"bot/body.png", &bot::body},
+            {"bot/sonar.png", &bot::sonar},
+            {"stage/spawnpoint.png", &stage::spawnpoint},
+            {"stage/possible.png", &stage::evaluation::possible},
+            {"stage/impossible.png", &stage::evaluation::impossible},
+            {"gui/box_checked.png", &gui::tick_box::checked},
+            {"gui/box_unchecked.png", &gui::tick_box::unchecked},
+            {"gui/slider_rail_l.png", &gui::slider::left},
+            {"gui/slider_rail.png", &gui::slider::centre},
+            {"gui/slider_rail_r.png", &gui::slider::right},
+            {"gui/slider_handle.png", &gui::slider::handle},
+            {"gui/push_button_pushed.png", &gui::button::pushed},
+            {"gui/push_button.png", &gui::button::neutral},
+            {"gui/text_box_l.png", &gui::text_box::left},
+            {"gui/text_box.png", &gui::text_box::centre},
+            {"gui/text_box_r.png", &gui::text_box::right},
+            {"gui/progress_bar_empty.png", &gui::progress_bar::empty},
+            {"gui/progress_bar_filled.png", &gui::progress_bar::filled},
+            {"gui/progress_bar_success.png", &gui::progress_bar::success},
+            {"gui/progress_bar_failed.png", &gui::progress_bar::failed}
+        };
+    }
 
-        success = success and textures::stage::evaluation::possible.loadFromFile(TEXTURES_PATH "stage/possible.png");
-        success = success and textures::stage::evaluation::impossible.loadFromFile(TEXTURES_PATH "stage/impossible.png");
+    namespace bundle {
+        const char magic[8] = {'P','C','M','P','A','S','E','T'};
+        const std::uint32_t version = 3;
+        /**
+         * \brief FNV-1a hash of a file's contents, stored with each entry so
+         * a texture file that has changed since it was bundled can be found
+         * \param data_ File contents
+         * \return The hash
+        */
+        std::uint64_t hash(const std::vector<char>& data_) {
+            std::uint64_t h = 0xCBF29CE484222325ull;
+            for (char c : data_) {
+                h ^= static_cast<unsigned char>(c);
+                h *= 0x100000001B3ull;
+            }
+            return h;
+        }
+        /**
+         * \brief Read a file into memory in one read
+         * \param path_ File to read
+         * \param data_ Receives the contents
+         * \return `false` if the file could not be read
+        */
+        bool read_file(const std::string& path_, std::vector<char>& data_) {
+            std::ifstream file(path_, std::ifstream::binary | std::ifstream::ate);
+            if (!file.good()) {return false;}
+            data_.resize(file.tellg());
+            file.seekg(0);
+            file.read(data_.data(), data_.size());
+            return file.good();
+        }
+        /**
+         * \brief Pack the encoded texture files into one bundle.
+         * The layout is the magic, version and count, then the path, size
+         * and hash of each file, then the files one after another
+         * \param textures_path_ Directory holding the texture files
+         * \param bundle_path_ File to write
+        */
+        void write(const std::string& textures_path_, const std::string& bundle_path_) {
+            auto list = entries();
+            std::vector<std::vector<char>> files(list.size());
+            for (unsigned int i = 0; i < list.size(); i++) {
+                if (!read_file(textures_path_ + list[i].path, files[i])) {
+                    throw std::runtime_error(std::string("Unable to read ") + list[i].path);
+                }
+            }
+            std::ofstream out(bundle_path_, std::ofstream::binary);
+            if (!out.good()) {throw std::runtime_error("Unable to write texture bundle");}
+            std::uint32_t count = list.size();
+            out.write(magic, sizeof(magic));
+            out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+            out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+            for (unsigned int i = 0; i < list.size(); i++) {
+                std::uint32_t path_size = std::strlen(list[i].path);
+                std::uint32_t file_size = files[i].size();
+                out.write(reinterpret_cast<const char*>(&path_size), sizeof(path_size));
+                out.write(list[i].path, path_size);
+                out.write(reinterpret_cast<const char*>(&file_size), sizeof(file_size));
+                std::uint64_t file_hash = hash(files[i]);
+                out.write(reinterpret_cast<const char*>(&file_hash), sizeof(file_hash));
+            }
+            for (auto& f : files) {out.write(f.data(), f.size());}
+        }
+        /**
+         * \brief Split a bundle written by `write()` back into its files.
+         * A file that has been changed since it was bundled is left out
+         * (as `{nullptr, 0}`), so it can be loaded from the texture files instead
+         * \param data_ The whole bundle
+         * \param textures_path_ Directory holding the texture files
+         * \param files_ Receives each file's contents, in `entries()` order
+         * \return `false` if the bundle is malformed or does not hold every entry
+        */
+        bool read(const std::vector<char>& data_, const std::string& textures_path_, std::vector<std::pair<const char*, std::size_t>>& files_) {
+            auto list = entries();
+            std::size_t at = 0;
+            auto take = [&] (void* out_, std::size_t size_) {
+                if (at + size_ > data_.size()) {return false;}
+                std::memcpy(out_, data_.data() + at, size_);
+                at += size_;
+                return true;
+            };
+            char m[8];
+            std::uint32_t v, count;
+            if (!take(m, sizeof(m)) or std::memcmp(m, magic, sizeof(m)) != 0) {return false;}
+            if (!take(&v, sizeof(v)) or v != version) {return false;}
+            if (!take(&count, sizeof(count)) or count != list.size()) {return false;}
+            std::vector<std::uint32_t> sizes(count);
+            std::vector<char> fresh(count, true);
+            std::vector<char> current;
+            for (unsigned int i = 0; i < count; i++) {
+                std::uint32_t path_size;
+                if (!take(&path_size, sizeof(path_size)) or at + path_size > data_.size()) {return false;}
+                if (std::string(data_.data() + at, path_size) != list[i].path) {return false;}
+                at += path_size;
+                std::uint64_t bundled;
+                if (!take(&sizes[i], sizeof(sizes[i])) or !take(&bundled, sizeof(bundled))) {return false;}
+                // Only a texture file that is still there can differ from the bundle
+                if (read_file(textures_path_ + list[i].path, current)) {fresh[i] = current.size() == sizes[i] and hash(current) == bundled;}
+            }
+            files_.resize(count);
+            for (unsigned int i = 0; i < count; i++) {
+                if (at + sizes[i] > data_.size()) {return false;}
+                if (fresh[i]) {files_[i] = std::make_pair(data_.data() + at, std::size_t(sizes[i]));}
+                else {files_[i] = std::make_pair(nullptr, 0);}
+                at += sizes[i];
+            }
+            return true;
+        }
+    }
 
+    /**
+     * \brief Pack images into `assets::atlas` and set each entry's region.
+     * Images are placed in rows (shelves), tallest first
+     * \param list_ Entries to set
+     * \param images_ Decoded image for each entry
+    */
+    void build_atlas(const std::vector<Entry>& list_, const std::vector<Image>& images_) {
+        const unsigned int max_width = 1024;
+        const unsigned int gap = 1; // Stops neighbours bleeding in when scaled
+        std::vector<unsigned int> order(images_.size());
+        for (unsigned int i = 0; i < order.size(); i++) {order[i] = i;}
+        std::stable_sort(order.begin(), order.end(), [&] (unsigned int a, unsigned int b) {return images_[a].getSize().y > images_[b].getSize().y;});
 
-        success = success and textures::gui::tick_box::checked.loadFromFile(TEXTURES_PATH "gui/box_checked.png");
-        success = success and textures::gui::tick_box::unchecked.loadFromFile(TEXTURES_PATH "gui/box_unchecked.png");
+        std::vector<Vector2u> places(images_.size());
+        unsigned int x = 0, y = 0, shelf = 0, width = 0;
+        for (unsigned int i : order) {
+            auto size = images_[i].getSize();
+            if (x > 0 and x + size.x > max_width) {
+                y += shelf + gap;
+                x = shelf = 0;
+            }
+            places[i] = Vector2u(x, y);
+            x += size.x + gap;
+            shelf = std::max(shelf, size.y);
+            width = std::max(width, x);
+        }
+        Image packed;
+        packed.create(std::max(width, 1u), std::max(y + shelf, 1u), Color::Transparent);
+        for (unsigned int i = 0; i < images_.size(); i++) {
+            packed.copy(images_[i], places[i].x, places[i].y);
+            auto size = images_[i].getSize();
+            list_[i].region->rect = IntRect(places[i].x, places[i].y, size.x, size.y);
+        }
+        if (!atlas.loadFromImage(packed)) {
+            throw std::runtime_error("Unable to create texture atlas");
+        }
+    }
 
-        success = success and textures::gui::slider::left.loadFromFile(TEXTURES_PATH "gui/slider_rail_l.png");
-        success = success and textures::gui::slider::centre.loadFromFile(TEXTURES_PATH "gui/slider_rail.png");
-        success = success and textures::gui::slider::right.loadFromFile(TEXTURES_PATH "gui/slider_rail_r.png");
-        success = success and textures::gui::slider::handle.loadFromFile(TEXTURES_PATH "gui/slider_handle.png");
+    void load_assets() {
 
-        success = success and textures::gui::button::pushed.loadFromFile(TEXTURES_PATH "gui/push_button_pushed.png");
-        success = success and textures::gui::button::neutral.loadFromFile(TEXTURES_PATH "gui/push_button.png");
+        std::cout << "Loading Assets...\n";
 
-        success = success and textures::gui::text_box::left.loadFromFile(TEXTURES_PATH "gui/text_box_l.png");
-        success = success and textures::gui::text_box::centre.loadFromFile(TEXTURES_PATH "gui/text_box.png");
-        success = success and textures::gui::text_box::right.loadFromFile(TEXTURES_PATH "gui/text_box_r.png");
+        auto list = entries();
+        std::vector<Image> images(list.size());
+        std::vector<char> success(list.size(), false);
 
-        success = success and textures::gui::progress_bar::empty.loadFromFile(TEXTURES_PATH "gui/progress_bar_empty.png");
-        success = success and textures::gui::progress_bar::filled.loadFromFile(TEXTURES_PATH "gui/progress_bar_filled.png");
-        success = success and textures::gui::progress_bar::success.loadFromFile(TEXTURES_PATH "gui/progress_bar_success.png");
-        success = success and textures::gui::progress_bar::failed.loadFromFile(TEXTURES_PATH "gui/progress_bar_failed.png");
+        // Decode every image in parallel, from the bundle where it is up to date
+        std::vector<char> data;
+        std::vector<std::pair<const char*, std::size_t>> files;
+        const bool bundled = bundle::read_file(BUNDLE_PATH, data) and bundle::read(data, TEXTURES_PATH, files);
+        auto decode = [&] (unsigned int first_, unsigned int step_) {
+            for (unsigned int i = first_; i < list.size(); i += step_) {
+                if (bundled and files[i].first) {success[i] = images[i].loadFromMemory(files[i].first, files[i].second);}
+                else {success[i] = images[i].loadFromFile(std::string(TEXTURES_PATH) + list[i].path);}
+            }
+        };
+        unsigned int thread_count = std::clamp<unsigned int>(std::thread::hardware_concurrency(), 1, list.size());
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < thread_count; t++) {threads.emplace_back(decode, t, thread_count);}
+        for (auto& t : threads) {t.join();}
 
+        bool all = std::all_of(success.begin(), success.end(), [] (char s) {return s;});
+        if (all) {build_atlas(list, images);}
 
-        success = success and fonts::arial.loadFromFile(FONTS_PATH "arial.ttf");
+        all = all and fonts::arial.loadFromFile(FONTS_PATH "arial.ttf");
 
-        if (!success) {
+        if (!all) {
             throw std::runtime_error("Unable to load file(s). Please add the files or re-install.");
         }
         std::cout << "Complete." << std::endl;
     }
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -3,20 +3,46 @@
 
 #include <SFML/Graphics.hpp>
 #include <vector>
+#include <utility>
 #include <string.h>
 #include "Assets.hpp"
+#include "Text.hpp"
 
 namespace gui {
     using namespace assets::textures::gui;
 
     const sf::Vector2u unit_size(32,32); // Size of each texture file (in pixels)
 
+    /**
+     * \brief Remembers the state a widget was last rendered in, so
+     * rendering can be skipped while nothing has changed
+    */
+    template <typename T>
+    class RenderedState {
+        T _state;
+        bool _valid = false;
+        public:
+        /**
+         * \brief Records `state_` as the rendered state
+         * \return `true` if `state_` differs from the last recorded state, or none has been recorded
+        */
+        bool changed(const T& state_) {
+            if (_valid and _state == state_) {return false;}
+            _state = state_;
+            _valid = true;
+            return true;
+        }
+        /**
+         * \brief Forces the next `changed()` to return `true`
+        */
+        void invalidate() {_valid = false;}
+    };
+
     class CellGrid;
 
     class Interactable : public sf::Sprite {
         protected:
         const sf::Vector2f& _pos;
-        sf::Texture _texture;
         sf::Vector2u _bounding_box;
         public:
         std::vector<unsigned int> cell_index;
@@ -187,6 +213,7 @@ namespace gui {
 
         sf::Texture _rail_sized;
         sf::Sprite _handle;
+        RenderedState<std::pair<T, sf::Vector2f>> _rendered;
 
         void size_rail() {
 
@@ -196,19 +223,19 @@ namespace gui {
 
             // Draw left side
             t.create(unit_size.x*_width_units, unit_size.y);
-            sf::Sprite rail_left(slider::left);
+            sf::Sprite rail_left = slider::left.sprite();
             t.draw(rail_left);
 
             // Draw the middle at the correct length
             // (no middle units if width = 2)
-            if (_width_units > 2) {
-                sf::Sprite rail(slider::centre, sf::IntRect(sf::Vector2i(0,0), sf::Vector2i(unit_size.x*(_width_units-2), unit_size.y)));
-                rail.setPosition(sf::Vector2f(unit_size.x,0));
+            for (unsigned int u = 1; u + 1 < _width_units; u++) {
+                sf::Sprite rail = slider::centre.sprite();
+                rail.setPosition(sf::Vector2f(unit_size.x*u,0));
                 t.draw(rail);
             }
 
             // Draw right side
-            sf::Sprite rail_right(slider::right);
+            sf::Sprite rail_right = slider::right.sprite();
             rail_right.setPosition(sf::Vector2f(unit_size.x*(_width_units-1), 0));
             t.draw(rail_right);
             t.display();
@@ -232,7 +259,7 @@ namespace gui {
         value(default_)
         {
             size_rail();
-            _handle.setTexture(slider::handle);
+            slider::handle.apply(_handle);
         }
         Slider<T>(unsigned int width_, T min_, T max_) : Slider(width_, min_, max_, min_) {}
 
@@ -254,6 +281,7 @@ namespace gui {
         }
 
         void render() override {
+            if (!_rendered.changed(std::make_pair(value, _pos))) {return;}
             position_handle();
             setTexture(_rail_sized);
         }
@@ -272,14 +300,15 @@ namespace gui {
     };
 
     class CheckBox : public Interactable {
+        RenderedState<bool> _rendered;
         public:
         bool value;
         CheckBox(bool default_) : Interactable(sf::Vector2u(32,32)), value(default_) {}
         CheckBox() : CheckBox(false) {}
 
         void render() override {
-            _texture = (value ? tick_box::checked : tick_box::unchecked);
-            setTexture(_texture);
+            if (!_rendered.changed(value)) {return;}
+            (value ? tick_box::checked : tick_box::unchecked).apply(*this);
         }
 
         void actions(const sf::Vector2i& mouse_pos, std::vector<Action> actions) override {
@@ -295,12 +324,13 @@ namespace gui {
     };
 
     class PushButton : public Interactable {
+        RenderedState<bool> _rendered;
         public:
         bool value;
         PushButton() : Interactable(sf::Vector2u(32,32)), value(false) {}
         void render() override {
-            _texture = (value ? button::pushed : button::neutral);
-            setTexture(_texture);
+            if (!_rendered.changed(value)) {return;}
+            (value ? button::pushed : button::neutral).apply(*this);
         }
         void actions(const sf::Vector2i& mouse_pos, std::vector<Action> actions_) override {
             for (auto act : actions_) {
@@ -326,20 +356,22 @@ namespace gui {
 
         std::string _text;
 
-        sf::Texture _t_text;
         sf::Texture _t_box_sized;
+        mutable text::Batch _label;
+        mutable sf::IntRect _label_rect; // Texture rect the label was laid out for
+        mutable sf::Color _label_colour; // Sprite colour the label was laid out for
 
         void size_box() {
             sf::RenderTexture t;
             t.create(unit_size.x*_width_units, unit_size.y);
-            sf::Sprite box_left(text_box::left);
+            sf::Sprite box_left = text_box::left.sprite();
             t.draw(box_left);
-            if (_width_units > 2) {
-                sf::Sprite box(text_box::centre, sf::IntRect(sf::Vector2i(0,0), sf::Vector2i(unit_size.x*(_width_units-2), unit_size.y)));
-                box.setPosition(sf::Vector2f(unit_size.x,0));
+            for (unsigned int u = 1; u + 1 < _width_units; u++) {
+                sf::Sprite box = text_box::centre.sprite();
+                box.setPosition(sf::Vector2f(unit_size.x*u,0));
                 t.draw(box);
             }
-            sf::Sprite rail_right(text_box::right);
+            sf::Sprite rail_right = text_box::right.sprite();
             rail_right.setPosition(sf::Vector2f(unit_size.x*(_width_units-1), 0));
             t.draw(rail_right);
             t.display();
@@ -348,40 +380,46 @@ namespace gui {
             setTexture(_t_box_sized);
         }
 
-        void load_text() {
-            sf::Sprite s(_t_box_sized);
-
-            sf::Text txt;
-            txt.setFont(assets::fonts::arial);
-            txt.setCharacterSize(_char_size);
-            txt.setString(_text);
-            txt.setOutlineColor(sf::Color::Black);
-            txt.setFillColor(sf::Color::Black);
-            txt.setPosition(_char_size/4, _char_size/2);
-
-            sf::RenderTexture t;
-            t.create(unit_size.x*_width_units, unit_size.y);
-            t.draw(s);
-            t.draw(txt);
-            t.display();
-            _t_text = t.getTexture();
+        // Lays the text out over the part of the box the sprite shows, tinted
+        // and cut off as it was when the text was drawn into the box texture
+        void load_text() const {
+            _label_rect = getTextureRect();
+            _label_colour = getColor();
+            const sf::Vector2f pos(float(_char_size/4) - _label_rect.left, float(_char_size/2) - _label_rect.top);
+            _label.clear();
+            _label.add(_text, pos, sf::Color::Black*_label_colour, sf::FloatRect(0, 0, _label_rect.width, _label_rect.height));
+        }
+        // Draws the box as `sf::Sprite` would, then the text over it.
+        // Two draw calls, as each text box has its own batch
+        void draw(sf::RenderTarget& target_, sf::RenderStates states_) const override {
+            if (getTextureRect() != _label_rect or getColor() != _label_colour) {load_text();}
+            sf::Sprite box(_t_box_sized, getTextureRect());
+            box.setColor(getColor());
+            states_.transform *= getTransform();
+            target_.draw(box, states_);
+            target_.draw(_label, states_);
         }
 
         public:
-        TextBox(unsigned int width_, std::string text_, unsigned int char_size_) : Sprite(), _width_units(width_), _char_size(char_size_), _text(text_) {
+        TextBox(unsigned int width_, std::string text_, unsigned int char_size_) : Sprite(), _width_units(width_), _char_size(char_size_), _text(text_), _label(char_size_) {
             size_box();
             load_text();
-            setTexture(_t_text);
         }
         TextBox(unsigned int width_, std::string text_) : TextBox(width_, text_, 16) {}
         TextBox(unsigned int width_) : TextBox(width_, "", 16) {}
         /**
-         * \brief Set the text to be displayed
+         * \brief Set the text to be displayed.
+         * The text is only redrawn if it has changed
         */
-        void set_text(std::string text_) {
+        void set_text(const std::string& text_) {
+            if (text_ == _text) {return;}
             _text = text_;
             load_text();
         }
+        /**
+         * \return The text being displayed
+        */
+        const std::string& get_text() const {return _text;}
     };
 
     class ProgressBar : public sf::Sprite {
@@ -393,6 +431,7 @@ namespace gui {
         sf::Texture _texture;
 
         State _state = NORMAL;
+        RenderedState<std::pair<unsigned int, State>> _rendered; // Filled width and state
 
         public:
 
@@ -400,28 +439,32 @@ namespace gui {
             render();
         }
 
+        /**
+         * \brief Redraws the bar, if the filled width or state has changed
+        */
         void render() {
-            auto texture_size = progress_bar::empty.getSize();
+            auto texture_size = progress_bar::empty.size();
             unsigned int progress_pixels = _progress * texture_size.x;
+            if (!_rendered.changed(std::make_pair(progress_pixels, _state))) {return;}
 
-            sf::Texture fill_texture;
+            const assets::Region* fill_texture = &progress_bar::filled;
             switch (_state)
             {
             case NORMAL:
-                fill_texture = progress_bar::filled;
+                fill_texture = &progress_bar::filled;
                 break;
             case SUCCESS:
-                fill_texture = progress_bar::success;
+                fill_texture = &progress_bar::success;
                 break;
             case FAIL:
-                fill_texture = progress_bar::failed;
+                fill_texture = &progress_bar::failed;
                 break;
             default:
                 break;
             }
 
-            sf::Sprite empty(progress_bar::empty);
-            sf::Sprite filled(fill_texture, sf::IntRect(sf::Vector2i(0,0), sf::Vector2i(progress_pixels, texture_size.y)));
+            sf::Sprite empty = progress_bar::empty.sprite();
+            sf::Sprite filled = fill_texture->sprite(sf::IntRect(sf::Vector2i(0,0), sf::Vector2i(progress_pixels, texture_size.y)));
             sf::RenderTexture t;
             t.create(texture_size.x, texture_size.y);
 
@@ -7,10 +7,13 @@
 #include <vector>
 #include <stdexcept>
 #include <cmath>
+#include <algorithm>
 #include <fstream>
 #include <json/json.h>
 #include <SFML/Graphics.hpp>
 
+#include "Random.hpp"
+
 namespace jcv {
     using namespace std;
     template<typename T>
@@ -57,6 +60,22 @@ namespace nn {
             shape(shape_),
             weights(weights_),
             bias(bias_) {}
+        /**
+         * \brief Add normally distributed noise to some of the weights and biases.
+         * Values are visited in a fixed order, so the same stream always
+         * gives the same result
+         * \param stream_ Stream to draw from, see `rng::MUTATION`
+         * \param rate_ Chance of each value being changed
+         * \param strength_ Standard deviation of the noise
+        */
+        void mutate(rng::Stream& stream_, double rate_, double strength_) {
+            for (double& w : weights) {
+                if (stream_.uniform() < rate_) {w += strength_*stream_.normal();}
+            }
+            for (double& b : bias) {
+                if (stream_.uniform() < rate_) {b += strength_*stream_.normal();}
+            }
+        }
     };
 
     class Network {
@@ -187,10 +206,59 @@ namespace nn {
          * \return Values of the output layer as a vector
         */
         vector<double> calculate(const vector<double>& input_) const {
-            vector<double> l_inputs = input_;
-            vector<double> l_outputs;
-            for (unsigned int l = 1; l < _layers; l++) {
-                // For every layer (excluding input layer)
+            return calculate(input_.data());
+        }
+        /**
+         * \brief Calculate the output layer values based on input layer values
+         * \param input_ Values of the input layer. Must hold `shape()[0]` values
+         * \return Values of the output layer as a vector
+        */
+        vector<double> calculate(const double* input_) const {
+            return calculate_from_sums(weighted_sums(input_));
+        }
+        /**
+         * \brief The weighted sums of the first layer after the input layer,
+         * before bias and the activation function are applied
+         * \param input_ Values of the input layer. Must hold `shape()[0]` values
+         * \return The weighted sum of each node
+        */
+        vector<double> weighted_sums(const double* input_) const {
+            vector<double> sums(_shape[1], 0.0);
+            for (unsigned int n = 0; n < _shape[1]; n++) {
+                for (unsigned int np = 0; np < _shape[0]; np++) {
+                    sums[n] += input_[np] * _weights[w_index(0, np, n)];
+                }
+            }
+            return sums;
+        }
+        /**
+         * \brief Updates weighted sums after a single input value changes.
+         * Costs one multiply-add per node rather than a full recalculation
+         * \param sums_ Weighted sums from `weighted_sums()`
+         * \param input_ Index of the input node that changed
+         * \param delta_ The change in the input value
+        */
+        void accumulate(vector<double>& sums_, unsigned int input_, double delta_) const {
+            const double* column = &_weights[w_index(0, input_, 0)];
+            for (unsigned int n = 0; n < _shape[1]; n++) {
+                sums_[n] += column[n] * delta_;
+            }
+        }
+        /**
+         * \brief Calculate the output layer values based on the weighted
+         * sums of the first layer after the input layer
+         * \param sums_ Weighted sums from `weighted_sums()`
+         * \return Values of the output layer as a vector
+        */
+        vector<double> calculate_from_sums(const vector<double>& sums_) const {
+            vector<double> l_inputs(_shape[1]);
+            for (unsigned int n = 0; n < _shape[1]; n++) {
+                double n_bias = _bias[b_index(1, n)];
+                l_inputs[n] = af_sig(sums_[n], n_bias);
+            }
+            vector<double> l_outputs = l_inputs;
+            for (unsigned int l = 2; l < _layers; l++) {
+                // For every layer (excluding input layer and the first layer)
                 l_outputs.resize(_shape[l]);
                 for (unsigned int n = 0; n < _shape[l]; n++) {
                     // For every node in current layer
@@ -213,6 +281,35 @@ namespace nn {
             }
             return l_outputs;
         }
+        /**
+         * \brief Calculate the output layer values for many inputs at once.
+         * Each weight is loaded once per batch rather than once per input,
+         * and results match `calculate()` exactly
+         * \param inputs_ `count_` sets of input layer values, one after another
+         * \param count_ Number of inputs
+         * \param outputs_ Receives `count_` sets of output layer values, one after another
+        */
+        void calculate_batch(const double* inputs_, size_t count_, double* outputs_) const {
+            vector<double> l_inputs(inputs_, inputs_ + count_*_shape[0]);
+            vector<double> l_outputs;
+            for (unsigned int l = 1; l < _layers; l++) {
+                const unsigned int width = _shape[l-1];
+                const unsigned int nodes = _shape[l];
+                l_outputs.assign(count_*nodes, 0.0);
+                for (size_t i = 0; i < count_; i++) {
+                    const double* in = &l_inputs[i*width];
+                    double* out = &l_outputs[i*nodes];
+                    for (unsigned int np = 0; np < width; np++) {
+                        // Weights from one node are stored together
+                        const double* row = &_weights[w_index(l-1, np, 0)];
+                        for (unsigned int n = 0; n < nodes; n++) {out[n] += in[np]*row[n];}
+                    }
+                    for (unsigned int n = 0; n < nodes; n++) {out[n] = af_sig(out[n], _bias[b_index(l, n)]);}
+                }
+                l_inputs.swap(l_outputs);
+            }
+            copy(l_inputs.begin(), l_inputs.end(), outputs_);
+        }
     };
 
     class Storage {
@@ -290,6 +387,7 @@ namespace nn {
         string _title = "Network";
         unsigned int _winx;
         unsigned int _winy;
+        unsigned int _max_lines = 20000; // Most weights drawn by `plot_network()`, `0` for no limit
         
         double sig(double x_) const {
             const double _e = 2.71828;
@@ -315,9 +413,20 @@ namespace nn {
             unsigned int layer_count = shape.size();
 
             const unsigned int node_r = 5;
+            const unsigned int node_points = 16;
+
+            // Level of detail: past the line budget, only the strongest weights are drawn
+            double min_weight = 0.0;
+            if (_max_lines > 0 and weights.size() > _max_lines) {
+                vector<double> magnitudes(weights.size());
+                for (unsigned int i = 0; i < weights.size(); i++) {magnitudes[i] = abs(weights[i]);}
+                nth_element(magnitudes.begin(), magnitudes.end() - _max_lines, magnitudes.end());
+                min_weight = *(magnitudes.end() - _max_lines);
+            }
 
-            sf::CircleShape node(node_r);
-            sf::VertexArray weight(sf::Lines, 2);
+            // Every weight and every node is batched, then drawn in one call each
+            sf::VertexArray lines(sf::Lines);
+            sf::VertexArray nodes(sf::Triangles);
             unsigned int bias_index = 0;
             unsigned int weights_index = 0;
             for (unsigned int l = 0; l < layer_count; l++) {
@@ -325,31 +434,44 @@ namespace nn {
                 unsigned int nx = ((l + 1)*_winx) / (layer_count + 1);
                 for (unsigned int n = 0; n < node_count; n++) {
                     unsigned int ny = ((n + 1)*_winy) / (node_count + 1);
-                    weight[0].position = sf::Vector2f(nx,ny);
                     if (l < (layer_count - 1)) {
                         unsigned int n2x = ((l + 2)*_winx) / (layer_count + 1);
                         for (unsigned int w = 0; w < shape[l+1]; w++) {
+                            if (abs(weights[weights_index]) < min_weight) {
+                                weights_index++;
+                                continue;
+                            }
                             unsigned int n2y = ((w + 1)*_winy) / (shape[l+1] + 1);
-                            weight[1].position = sf::Vector2f(n2x, n2y);
 
                             double s = sig(weights[weights_index]);
-                            weight[0].color = sf::Color(255*s, 255*-s, 255, 255);
-                            weight[1].color = sf::Color(255*s, 255*-s, 255, 255);
-
-
-                            texture.draw(weight);
+                            sf::Color colour(255*s, 255*-s, 255, 255);
+                            lines.append(sf::Vertex(sf::Vector2f(nx, ny), colour));
+                            lines.append(sf::Vertex(sf::Vector2f(n2x, n2y), colour));
                             weights_index++;
                         }
                     }
                     double s = sig(bias[bias_index]);
-                    node.setFillColor(sf::Color(255, 255*s, 255*(1-s), 255));
-                    node.setPosition(nx - node_r, ny - node_r);
-                    texture.draw(node);
+                    sf::Color colour(255, 255*s, 255*(1-s), 255);
+                    for (unsigned int p = 0; p < node_points; p++) {
+                        double a1 = (2*3.14159265358979*p)/node_points;
+                        double a2 = (2*3.14159265358979*(p + 1))/node_points;
+                        nodes.append(sf::Vertex(sf::Vector2f(nx, ny), colour));
+                        nodes.append(sf::Vertex(sf::Vector2f(nx + node_r*cos(a1), ny + node_r*sin(a1)), colour));
+                        nodes.append(sf::Vertex(sf::Vector2f(nx + node_r*cos(a2), ny + node_r*sin(a2)), colour));
+                    }
                     bias_index++;
                 }
             }
+            texture.draw(lines);
+            texture.draw(nodes);
             return texture.getTexture();
         }
+        /**
+         * \brief Limit how many weights `plot_network()` draws. Past the
+         * limit, the weights closest to zero are left out
+         * \param max_lines_ Most weights to draw, `0` for no limit
+        */
+        void set_max_lines(unsigned int max_lines_) {_max_lines = max_lines_;}
     };
 }
 
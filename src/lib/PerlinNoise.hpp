@@ -236,6 +236,39 @@ namespace siv
 		[[nodiscard]]
 		value_type normalizedOctave3D_01(value_type x, value_type y, value_type z, std::int32_t octaves, value_type persistence = value_type(0.5)) const noexcept;
 
+		///////////////////////////////////////
+		//
+		//	Flat 2D noise (The result is in the range [-1, 1])
+		//	A true 2D kernel (4 gradients, 3 lerps) rather than noise3D() with a constant z.
+		//	Gives different values to noise2D() for the same seed
+		//
+
+		[[nodiscard]]
+		value_type flatNoise2D(value_type x, value_type y) const noexcept;
+
+		[[nodiscard]]
+		value_type flatNoise2D_01(value_type x, value_type y) const noexcept;
+
+		[[nodiscard]]
+		value_type flatOctave2D(value_type x, value_type y, std::int32_t octaves, value_type persistence = value_type(0.5)) const noexcept;
+
+		[[nodiscard]]
+		value_type flatOctave2D_01(value_type x, value_type y, std::int32_t octaves, value_type persistence = value_type(0.5)) const noexcept;
+
+		///////////////////////////////////////
+		//
+		//	Octave noise with the number of octaves fixed at compile time (The result is clamped and remapped to the range [0, 1])
+		//	The octave loop can be unrolled. Results match the versions taking a runtime octave count
+		//
+
+		template <std::int32_t Octaves>
+		[[nodiscard]]
+		value_type octave2D_01(value_type x, value_type y, value_type persistence = value_type(0.5)) const noexcept;
+
+		template <std::int32_t Octaves>
+		[[nodiscard]]
+		value_type flatOctave2D_01(value_type x, value_type y, value_type persistence = value_type(0.5)) const noexcept;
+
 	private:
 
 		state_type m_permutation;
@@ -300,6 +333,14 @@ namespace siv
 			return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
 		}
 
+		template <class Float>
+		[[nodiscard]]
+		inline constexpr Float Grad(const std::uint8_t hash, const Float x, const Float y) noexcept
+		{
+			// Diagonal gradients keep the result in the range [-1, 1]
+			return ((hash & 1) == 0 ? x : -x) + ((hash & 2) == 0 ? y : -y);
+		}
+
 		template <class Float>
 		[[nodiscard]]
 		inline constexpr Float Remap_01(const Float x) noexcept
@@ -367,6 +408,63 @@ namespace siv
 			return result;
 		}
 
+		template <class Noise, class Float>
+		[[nodiscard]]
+		inline auto FlatOctave2D(const Noise& noise, Float x, Float y, const std::int32_t octaves, const Float persistence) noexcept
+		{
+			using value_type = Float;
+			value_type result = 0;
+			value_type amplitude = 1;
+
+			for (std::int32_t i = 0; i < octaves; ++i)
+			{
+				result += (noise.flatNoise2D(x, y) * amplitude);
+				x *= 2;
+				y *= 2;
+				amplitude *= persistence;
+			}
+
+			return result;
+		}
+
+		template <std::int32_t Octaves, class Noise, class Float>
+		[[nodiscard]]
+		inline auto FixedOctave2D(const Noise& noise, Float x, Float y, const Float persistence) noexcept
+		{
+			using value_type = Float;
+			value_type result = 0;
+			value_type amplitude = 1;
+
+			for (std::int32_t i = 0; i < Octaves; ++i)
+			{
+				result += (noise.noise2D(x, y) * amplitude);
+				x *= 2;
+				y *= 2;
+				amplitude *= persistence;
+			}
+
+			return result;
+		}
+
+		template <std::int32_t Octaves, class Noise, class Float>
+		[[nodiscard]]
+		inline auto FixedFlatOctave2D(const Noise& noise, Float x, Float y, const Float persistence) noexcept
+		{
+			using value_type = Float;
+			value_type result = 0;
+			value_type amplitude = 1;
+
+			for (std::int32_t i = 0; i < Octaves; ++i)
+			{
+				result += (noise.flatNoise2D(x, y) * amplitude);
+				x *= 2;
+				y *= 2;
+				amplitude *= persistence;
+			}
+
+			return result;
+		}
+
 		template <class Noise, class Float>
 		[[nodiscard]]
 		inline auto Octave3D(const Noise& noise, Float x, Float y, Float z, const std::int32_t octaves, const Float persistence) noexcept
@@ -652,6 +750,71 @@ namespace siv
 	{
 		return perlin_detail::Remap_01(normalizedOctave3D(x, y, z, octaves, persistence));
 	}
+
+	///////////////////////////////////////
+
+	template <class Float>
+	inline typename BasicPerlinNoise<Float>::value_type BasicPerlinNoise<Float>::flatNoise2D(const value_type x, const value_type y) const noexcept
+	{
+		const value_type _x = std::floor(x);
+		const value_type _y = std::floor(y);
+
+		const std::int32_t ix = static_cast<std::int32_t>(_x) & 255;
+		const std::int32_t iy = static_cast<std::int32_t>(_y) & 255;
+
+		const value_type fx = (x - _x);
+		const value_type fy = (y - _y);
+
+		const value_type u = perlin_detail::Fade(fx);
+		const value_type v = perlin_detail::Fade(fy);
+
+		const std::uint8_t A = (m_permutation[ix & 255] + iy) & 255;
+		const std::uint8_t B = (m_permutation[(ix + 1) & 255] + iy) & 255;
+
+		const value_type p0 = perlin_detail::Grad(m_permutation[A], fx, fy);
+		const value_type p1 = perlin_detail::Grad(m_permutation[B], fx - 1, fy);
+		const value_type p2 = perlin_detail::Grad(m_permutation[(A + 1) & 255], fx, fy - 1);
+		const value_type p3 = perlin_detail::Grad(m_permutation[(B + 1) & 255], fx - 1, fy - 1);
+
+		const value_type q0 = perlin_detail::Lerp(p0, p1, u);
+		const value_type q1 = perlin_detail::Lerp(p2, p3, u);
+
+		return perlin_detail::Lerp(q0, q1, v);
+	}
+
+	template <class Float>
+	inline typename BasicPerlinNoise<Float>::value_type BasicPerlinNoise<Float>::flatNoise2D_01(const value_type x, const value_type y) const noexcept
+	{
+		return perlin_detail::Remap_01(flatNoise2D(x, y));
+	}
+
+	template <class Float>
+	inline typename BasicPerlinNoise<Float>::value_type BasicPerlinNoise<Float>::flatOctave2D(const value_type x, const value_type y, const std::int32_t octaves, const value_type persistence) const noexcept
+	{
+		return perlin_detail::FlatOctave2D(*this, x, y, octaves, persistence);
+	}
+
+	template <class Float>
+	inline typename BasicPerlinNoise<Float>::value_type BasicPerlinNoise<Float>::flatOctave2D_01(const value_type x, const value_type y, const std::int32_t octaves, const value_type persistence) const noexcept
+	{
+		return perlin_detail::RemapClamp_01(flatOctave2D(x, y, octaves, persistence));
+	}
+
+	///////////////////////////////////////
+
+	template <class Float>
+	template <std::int32_t Octaves>
+	inline typename BasicPerlinNoise<Float>::value_type BasicPerlinNoise<Float>::octave2D_01(const value_type x, const value_type y, const value_type persistence) const noexcept
+	{
+		return perlin_detail::RemapClamp_01(perlin_detail::FixedOctave2D<Octaves>(*this, x, y, persistence));
+	}
+
+	template <class Float>
+	template <std::int32_t Octaves>
+	inline typename BasicPerlinNoise<Float>::value_type BasicPerlinNoise<Float>::flatOctave2D_01(const value_type x, const value_type y, const value_type persistence) const noexcept
+	{
+		return perlin_detail::RemapClamp_01(perlin_detail::FixedFlatOctave2D<Octaves>(*this, x, y, persistence));
+	}
 }
 
 # undef SIVPERLIN_NODISCARD_CXX20
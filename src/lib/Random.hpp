@@ -0,0 +1,170 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+#include <cmath>
+#include <stdexcept>
+
+namespace rng {
+    /**
+     * \brief Identifies one stream of random numbers within a training run.
+     * Every combination of fields gives an independent stream, so a worker
+     * can make the numbers for any individual's episode without knowing
+     * what any other worker has drawn
+    */
+    struct Key {
+        std::uint64_t run;
+        std::uint32_t generation;
+        std::uint32_t individual;
+        std::uint32_t episode;
+        Key() : run(0), generation(0), individual(0), episode(0) {}
+        Key(std::uint64_t run_, std::uint32_t generation_ = 0, std::uint32_t individual_ = 0, std::uint32_t episode_ = 0) :
+            run(run_),
+            generation(generation_),
+            individual(individual_),
+            episode(episode_) {}
+    };
+    /**
+     * \brief What a stream is used for. Streams with the same key but a
+     * different purpose are independent
+    */
+    enum Purpose : std::uint32_t {
+        GENERAL,
+        STAGE, // Stage seeds
+        MUTATION // Changes to network values
+    };
+    /**
+     * \brief Mix a 64 bit value (SplitMix64 finaliser)
+     * \param x_ Value
+     * \return Mixed value
+    */
+    std::uint64_t mix(std::uint64_t x_) {
+        x_ += 0x9E3779B97F4A7C15ull;
+        x_ = (x_ ^ (x_ >> 30))*0xBF58476D1CE4E5B9ull;
+        x_ = (x_ ^ (x_ >> 27))*0x94D049BB133111EBull;
+        return x_ ^ (x_ >> 31);
+    }
+    /**
+     * \brief The Philox4x32-10 block function. Turns a 128 bit counter and a
+     * 64 bit key into 128 random bits, with no state carried between calls
+     * \param ctr_ Counter, replaced by the random bits
+     * \param key_ Key
+    */
+    void philox(std::uint32_t ctr_[4], const std::uint32_t key_[2]) {
+        std::uint32_t k0 = key_[0];
+        std::uint32_t k1 = key_[1];
+        for (unsigned int round = 0; round < 10; round++) {
+            const std::uint64_t p0 = std::uint64_t(0xD2511F53u)*ctr_[0];
+            const std::uint64_t p1 = std::uint64_t(0xCD9E8D57u)*ctr_[2];
+            const std::uint32_t c1 = ctr_[1];
+            const std::uint32_t c3 = ctr_[3];
+            ctr_[0] = std::uint32_t(p1 >> 32) ^ c1 ^ k0;
+            ctr_[1] = std::uint32_t(p1);
+            ctr_[2] = std::uint32_t(p0 >> 32) ^ c3 ^ k1;
+            ctr_[3] = std::uint32_t(p0);
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+    }
+    /**
+     * \brief A counter-based random number generator.
+     * The n-th number of a stream depends only on its key, purpose and n,
+     * so results are the same whatever order streams are used in, on any
+     * number of threads or processes
+    */
+    class Stream {
+        private:
+        std::uint32_t _key[2];
+        std::uint32_t _ctr[4]; // Block index, episode, individual, generation
+        std::uint32_t _block[4];
+        unsigned int _used = 4; // Words of `_block` already returned
+
+        bool _spare_ready = false;
+        double _spare = 0.0;
+
+        public:
+        /**
+         * \param key_ Which stream
+         * \param purpose_ What the stream is used for
+        */
+        Stream(const Key& key_, Purpose purpose_ = GENERAL) {
+            const std::uint64_t k = mix(key_.run ^ mix(purpose_));
+            _key[0] = std::uint32_t(k);
+            _key[1] = std::uint32_t(k >> 32);
+            _ctr[0] = 0;
+            _ctr[1] = key_.episode;
+            _ctr[2] = key_.individual;
+            _ctr[3] = key_.generation;
+        }
+        /**
+         * \return 32 random bits
+        */
+        std::uint32_t next() {
+            if (_used == 4) {
+                if (_ctr[0] == 0xFFFFFFFFu) {throw std::runtime_error("Random stream exhausted");}
+                for (unsigned int i = 0; i < 4; i++) {_block[i] = _ctr[i];}
+                philox(_block, _key);
+                _ctr[0]++;
+                _used = 0;
+            }
+            return _block[_used++];
+        }
+        /**
+         * \return 64 random bits
+        */
+        std::uint64_t next64() {
+            const std::uint64_t hi = next();
+            return (hi << 32) | next();
+        }
+        /**
+         * \return A uniform value in [0, 1), with 53 bits of precision
+        */
+        double uniform() {
+            return (next64() >> 11)*(1.0/9007199254740992.0);
+        }
+        /**
+         * \param min_ Lowest value
+         * \param max_ Highest value (excluded)
+         * \return A uniform value in [min_, max_)
+        */
+        double uniform(double min_, double max_) {
+            return min_ + (max_ - min_)*uniform();
+        }
+        /**
+         * \param n_ Number of possible values, must be greater than `0`
+         * \return A uniform integer in [0, n_), without modulo bias
+        */
+        std::uint32_t below(std::uint32_t n_) {
+            if (n_ == 0) {throw std::runtime_error("Range must not be empty");}
+            // Lemire's multiply and reject
+            std::uint64_t m = std::uint64_t(next())*n_;
+            if (std::uint32_t(m) < n_) {
+                const std::uint32_t limit = (0u - n_) % n_;
+                while (std::uint32_t(m) < limit) {m = std::uint64_t(next())*n_;}
+            }
+            return std::uint32_t(m >> 32);
+        }
+        /**
+         * \return A normally distributed value with mean `0` and standard deviation `1`
+        */
+        double normal() {
+            if (_spare_ready) {
+                _spare_ready = false;
+                return _spare;
+            }
+            // Box-Muller
+            const double u = 1.0 - uniform(); // (0, 1], so the log is finite
+            const double v = uniform();
+            const double r = std::sqrt(-2.0*std::log(u));
+            _spare = r*std::sin(2*3.14159265358979323846*v);
+            _spare_ready = true;
+            return r*std::cos(2*3.14159265358979323846*v);
+        }
+        /**
+         * \return The number of 128 bit blocks drawn so far
+        */
+        std::uint32_t blocks() const {return _ctr[0];}
+    };
+}
+
+#endif
@@ -5,14 +5,35 @@
 #include <iostream>
 #include <cmath>
 #include <chrono>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <cstdio>
 
 #include <SFML/Graphics.hpp>
 
 #include "NeuralNetwork.hpp"
 #include "PerlinNoise.hpp"
 #include "Assets.hpp"
+#include "Random.hpp"
+#include "Text.hpp"
 
 #include<windows.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 const double pi = 3.14159265358979;
 
@@ -40,6 +61,74 @@ namespace radians {
 }
 
 namespace rs {
+    /**
+     * \brief The sine and cosine of an angle, solved together.
+     * The angle is reduced to [-pi/4, pi/4] and both are found by polynomial.
+     * Measured within 2.3e-16 of `sin`/`cos` for |angle| < 1e6. Larger
+     * angles lose accuracy as the reduction runs out of bits, so keep angles
+     * wrapped (rotations already are). Any angle, NaN included, is safe to pass.
+     * Free of branches and library calls so loops over it can be vectorised
+     * \param a_ Angle in radians
+     * \param s_ Set to the sine
+     * \param c_ Set to the cosine
+    */
+    void sincos(double a_, double& s_, double& c_) {
+        // Cody-Waite reduction by pi/2, split so each product is exact.
+        // Adding 1.5*2^52 rounds to a whole number of quadrants, left in the low bits
+        const double shifted = a_*0.63661977236758134308 + 6755399441055744.0;
+        const double q = shifted - 6755399441055744.0;
+        const double r = ((a_ - q*1.57079632673412561417e+00) - q*6.07710050630396597660e-11) - q*2.02226624871116645580e-21;
+        const double z = r*r;
+        const double sr = r + r*z*(-1.66666666666666324348e-01 + z*(8.33333333332248946124e-03 + z*(-1.98412698298579493134e-04
+                        + z*(2.75573137070700676789e-06 + z*(-2.50507602534068634195e-08 + z*1.58969099521155010221e-10)))));
+        const double cr = 1.0 - 0.5*z + z*z*(4.16666666666666019037e-02 + z*(-1.38888888888741095749e-03 + z*(2.48015872894767294178e-05
+                        + z*(-2.75573143513906633035e-07 + z*(2.08757232129817482790e-09 + z*-1.13596475577881948265e-11)))));
+        // Quadrant, read from the bits rather than converted, which would
+        // overflow for huge or NaN angles
+        std::uint64_t bits;
+        std::memcpy(&bits, &shifted, sizeof(bits));
+        const unsigned int n = static_cast<unsigned int>(bits);
+        const double s = (n & 1) ? cr : sr;
+        const double c = (n & 1) ? sr : cr;
+        s_ = (n & 2) ? -s : s;
+        c_ = ((n + 1) & 2) ? -c : c;
+    }
+    /**
+     * \param x_ A value other than `0`
+     * \return The index of the lowest set bit
+    */
+    unsigned int lowest_bit(std::uint64_t x_) {
+        #if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(x_);
+        #else
+        unsigned int n = 0;
+        while (!(x_ & 1)) {x_ >>= 1; n++;}
+        return n;
+        #endif
+    }
+    /**
+     * \brief A view of contiguous values owned elsewhere.
+     * Only valid while the owner is unchanged
+    */
+    template <typename T>
+    struct Span {
+        T* first;
+        std::size_t count;
+        Span(T* first_, std::size_t count_) : first(first_), count(count_) {}
+        T* begin() const {return first;}
+        T* end() const {return first + count;}
+        std::size_t size() const {return count;}
+        T& operator[](std::size_t i_) const {return first[i_];}
+    };
+    /**
+     * \brief The sines and cosines of many angles. See `rs::sincos()`
+     * \param a_ Angles in radians
+     * \param s_ Receives `a_.size()` sines
+     * \param c_ Receives `a_.size()` cosines
+    */
+    void sincos(Span<const double> a_, double* s_, double* c_) {
+        for (std::size_t i = 0; i < a_.size(); i++) {sincos(a_[i], s_[i], c_[i]);}
+    }
     /**
      * \brief Represents a point in 2D space
     */
@@ -52,8 +141,55 @@ namespace rs {
         Vector2(Vector2<G> vect_) : x(vect_.x), y(vect_.y) {}
         Vector2(T x_, T y_) : x(x_), y(y_) {}
         void from_bearing(double d_, double r_) {
-            x = cos(r_) * d_;
-            y = sin(r_) * d_;
+            double s, c;
+            sincos(r_, s, c);
+            x = c * d_;
+            y = s * d_;
+        }
+        /**
+         * \return This vector rotated by the rotation whose cosine and sine
+         * are the x and y of `rot_`
+        */
+        Vector2 rotated(Vector2 rot_) const {
+            return Vector2(x*rot_.x - y*rot_.y, x*rot_.y + y*rot_.x);
+        }
+    };
+    /**
+     * \brief Many points in 2D space, with the x and y components stored
+     * in separate arrays so they can be processed in batches
+    */
+    template <typename T>
+    struct Vectors2 {
+        std::vector<T> x;
+        std::vector<T> y;
+        Vectors2() {}
+        Vectors2(std::size_t size_) : x(size_), y(size_) {}
+        std::size_t size() const {return x.size();}
+        void resize(std::size_t size_) {
+            x.resize(size_);
+            y.resize(size_);
+        }
+        void push_back(Vector2<T> vect_) {
+            x.push_back(vect_.x);
+            y.push_back(vect_.y);
+        }
+        Vector2<T> operator[](std::size_t i_) const {return Vector2<T>(x[i_], y[i_]);}
+        void set(std::size_t i_, Vector2<T> vect_) {
+            x[i_] = vect_.x;
+            y[i_] = vect_.y;
+        }
+        /**
+         * \brief Replace the contents with one vector per bearing
+         * \param d_ Length of each vector
+         * \param r_ Bearings in radians
+        */
+        void from_bearings(double d_, Span<const double> r_) {
+            resize(r_.size());
+            sincos(r_, y.data(), x.data());
+            for (std::size_t i = 0; i < size(); i++) {
+                x[i] *= d_;
+                y[i] *= d_;
+            }
         }
     };
     /**
@@ -66,10 +202,353 @@ namespace rs {
         Position(Vector2<double> pos_, double rot_) : position(pos_), rotation(rot_) {}
         Position(double x_, double y_, double rot_) : position(x_, y_), rotation(rot_) {}
     };
+    /**
+     * \brief A read-only file mapped into memory.
+     * Only the pages that are read are loaded
+    */
+    class MappedFile {
+        private:
+        #ifdef _WIN32
+        HANDLE _file = INVALID_HANDLE_VALUE;
+        HANDLE _mapping = NULL;
+        #else
+        int _file = -1;
+        #endif
+        const void* _view = nullptr;
+        std::size_t _size = 0;
+
+        public:
+        MappedFile() {}
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile() {close();}
+        /**
+         * \brief Map a whole file, closing any file already mapped
+         * \param path_ File to map
+         * \return `false` if the file could not be opened or mapped
+        */
+        bool open(const std::string& path_) {
+            close();
+            #ifdef _WIN32
+            _file = CreateFileA(path_.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (_file == INVALID_HANDLE_VALUE) {return false;}
+            LARGE_INTEGER size;
+            GetFileSizeEx(_file, &size);
+            _size = static_cast<std::size_t>(size.QuadPart);
+            _mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (_mapping != NULL) {_view = MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);}
+            #else
+            _file = ::open(path_.c_str(), O_RDONLY);
+            if (_file < 0) {return false;}
+            struct stat info;
+            fstat(_file, &info);
+            _size = info.st_size;
+            void* view = _size > 0 ? mmap(nullptr, _size, PROT_READ, MAP_SHARED, _file, 0) : MAP_FAILED;
+            if (view != MAP_FAILED) {_view = view;}
+            #endif
+            if (_view == nullptr) {close(); return false;}
+            return true;
+        }
+        /**
+         * \brief Unmap the file. Pointers from `data()` become invalid
+        */
+        void close() {
+            #ifdef _WIN32
+            if (_view != nullptr) {UnmapViewOfFile(_view);}
+            if (_mapping != NULL) {CloseHandle(_mapping);}
+            if (_file != INVALID_HANDLE_VALUE) {CloseHandle(_file);}
+            _file = INVALID_HANDLE_VALUE;
+            _mapping = NULL;
+            #else
+            if (_view != nullptr) {munmap(const_cast<void*>(_view), _size);}
+            if (_file >= 0) {::close(_file);}
+            _file = -1;
+            #endif
+            _view = nullptr;
+            _size = 0;
+        }
+        /**
+         * \return The start of the file, or `nullptr` if nothing is mapped
+        */
+        const char* data() const {return static_cast<const char*>(_view);}
+        /**
+         * \return The size of the file in bytes
+        */
+        std::size_t size() const {return _size;}
+    };
 }
 
 namespace stage {
     using namespace assets::textures::stage;
+    /**
+     * \brief The noise function used to generate a stage
+    */
+    enum NoiseKernel {
+        LEGACY, // 3D noise with a constant z. Matches stages from earlier versions
+        FLAT // True 2D noise. Faster, but gives a different stage for the same seed
+    };
+    /**
+     * \brief A straight piece of a collision area's outline
+    */
+    struct Segment {
+        rs::Vector2<double> a;
+        rs::Vector2<double> b;
+        Segment() {}
+        Segment(rs::Vector2<double> a_, rs::Vector2<double> b_) : a(a_), b(b_) {}
+    };
+    /**
+     * \brief The outlines of collision areas, traced from a grid of noise
+     * samples with marching squares. Segments are held in a bounding volume
+     * hierarchy so rays can be tested against them in O(log n)
+    */
+    class Contours {
+        private:
+        struct Node {
+            double min_x, min_y, max_x, max_y;
+            unsigned int first; // First entry of `_order` (leaf) or left child (branch)
+            unsigned int right; // Right child (branch)
+            unsigned int count; // Number of segments, `0` for a branch
+        };
+
+        static const unsigned int leaf_size = 4;
+
+        std::vector<Segment> _segments;
+        std::vector<std::uint64_t> _edges; // The two grid edges each segment joins, used to chain polylines
+        std::vector<Node> _nodes;
+        std::vector<unsigned int> _order; // Segment indices, grouped by leaf
+
+        void add(rs::Vector2<double> a_, rs::Vector2<double> b_, std::uint64_t ea_, std::uint64_t eb_) {
+            _segments.push_back(Segment(a_, b_));
+            _edges.push_back(ea_);
+            _edges.push_back(eb_);
+        }
+
+        unsigned int build(unsigned int first_, unsigned int count_) {
+            // Entries [first_, first_ + count_) of `_order` are reordered in place
+            unsigned int index = _nodes.size();
+            _nodes.push_back(Node());
+            Node node;
+            node.min_x = node.min_y = 1e300;
+            node.max_x = node.max_y = -1e300;
+            for (unsigned int i = first_; i < first_ + count_; i++) {
+                const Segment& s = _segments[_order[i]];
+                node.min_x = std::min({node.min_x, s.a.x, s.b.x});
+                node.min_y = std::min({node.min_y, s.a.y, s.b.y});
+                node.max_x = std::max({node.max_x, s.a.x, s.b.x});
+                node.max_y = std::max({node.max_y, s.a.y, s.b.y});
+            }
+            if (count_ <= leaf_size) {
+                node.first = first_;
+                node.count = count_;
+                _nodes[index] = node;
+                return index;
+            }
+            // Split at the median centre along the longest axis
+            const bool split_x = (node.max_x - node.min_x) > (node.max_y - node.min_y);
+            const unsigned int half = count_/2;
+            std::nth_element(
+                _order.begin() + first_, _order.begin() + first_ + half, _order.begin() + first_ + count_,
+                [this, split_x] (unsigned int i, unsigned int j)
+                {
+                    const Segment& a = _segments[i];
+                    const Segment& b = _segments[j];
+                    return split_x ? (a.a.x + a.b.x) < (b.a.x + b.b.x) : (a.a.y + a.b.y) < (b.a.y + b.b.y);
+                }
+            );
+            node.first = build(first_, half);
+            node.right = build(first_ + half, count_ - half);
+            node.count = 0;
+            _nodes[index] = node;
+            return index;
+        }
+
+        static bool hit_box(const Node& n_, rs::Vector2<double> o_, rs::Vector2<double> inv_, double max_) {
+            double t1 = (n_.min_x - o_.x)*inv_.x;
+            double t2 = (n_.max_x - o_.x)*inv_.x;
+            double tmin = std::min(t1, t2);
+            double tmax = std::max(t1, t2);
+            t1 = (n_.min_y - o_.y)*inv_.y;
+            t2 = (n_.max_y - o_.y)*inv_.y;
+            tmin = std::max(tmin, std::min(t1, t2));
+            tmax = std::min(tmax, std::max(t1, t2));
+            return tmax >= std::max(tmin, 0.0) and tmin <= max_;
+        }
+
+        public:
+        Contours() {}
+        /**
+         * \brief Trace the outlines of a sampled field
+         * \param samples_ Field values, row by row
+         * \param nx_ Number of samples per row
+         * \param ny_ Number of rows
+         * \param spacing_ Distance in pixels between samples
+         * \param threshold_ Values above this are inside a collision area
+        */
+        Contours(const std::vector<double>& samples_, unsigned int nx_, unsigned int ny_, double spacing_, double threshold_) {
+            // Edge ids: 2*(corner index) for the edge to the right of a corner, +1 for the edge below it
+            auto crossing = [&] (unsigned int x_, unsigned int y_, bool down_) {
+                const unsigned int i = y_*nx_ + x_;
+                const double va = samples_[i];
+                const double vb = samples_[down_ ? i + nx_ : i + 1];
+                const double t = (threshold_ - va)/(vb - va);
+                return down_ ?
+                    rs::Vector2<double>(x_*spacing_, (y_ + t)*spacing_) :
+                    rs::Vector2<double>((x_ + t)*spacing_, y_*spacing_);
+            };
+            for (unsigned int y = 0; y + 1 < ny_; y++) {
+                for (unsigned int x = 0; x + 1 < nx_; x++) {
+                    const unsigned int i = y*nx_ + x;
+                    const double v[4] = {samples_[i], samples_[i + 1], samples_[i + nx_ + 1], samples_[i + nx_]};
+                    unsigned int c = 0;
+                    for (unsigned int k = 0; k < 4; k++) {if (v[k] > threshold_) {c |= 1 << k;}}
+                    if (c == 0 or c == 15) {continue;}
+
+                    // Cell edges: 0 top, 1 right, 2 bottom, 3 left
+                    const std::uint64_t id[4] = {
+                        2*std::uint64_t(i),
+                        2*std::uint64_t(i + 1) + 1,
+                        2*std::uint64_t(i + nx_),
+                        2*std::uint64_t(i) + 1
+                    };
+                    const rs::Vector2<double> p[4] = {
+                        crossing(x, y, false),
+                        crossing(x + 1, y, true),
+                        crossing(x, y + 1, false),
+                        crossing(x, y, true)
+                    };
+                    auto join = [&] (unsigned int e1_, unsigned int e2_) {add(p[e1_], p[e2_], id[e1_], id[e2_]);};
+
+                    const bool centre = (v[0] + v[1] + v[2] + v[3])/4 > threshold_;
+                    switch (c)
+                    {
+                    case 1: case 14: join(3, 0); break;
+                    case 2: case 13: join(0, 1); break;
+                    case 3: case 12: join(3, 1); break;
+                    case 4: case 11: join(1, 2); break;
+                    case 6: case 9: join(0, 2); break;
+                    case 7: case 8: join(3, 2); break;
+                    case 5:
+                        if (centre) {join(0, 1); join(2, 3);}
+                        else {join(3, 0); join(1, 2);}
+                        break;
+                    case 10:
+                        if (centre) {join(3, 0); join(1, 2);}
+                        else {join(0, 1); join(2, 3);}
+                        break;
+                    default: break;
+                    }
+                }
+            }
+            _order.resize(_segments.size());
+            for (unsigned int i = 0; i < _order.size(); i++) {_order[i] = i;}
+            if (!_segments.empty()) {build(0, _segments.size());}
+        }
+        /**
+         * \return `true` if there are no outlines
+        */
+        bool empty() const {return _segments.empty();}
+        /**
+         * \return Every outline segment
+        */
+        const std::vector<Segment>& segments() const {return _segments;}
+        /**
+         * \brief Joins segments that share an end into polylines.
+         * Closed outlines repeat their first point at the end
+         * \return The outlines as lists of points
+        */
+        std::vector<std::vector<rs::Vector2<double>>> polylines() const {
+            std::unordered_map<std::uint64_t, unsigned int> ends[2]; // Up to two segments meet at each grid edge
+            for (unsigned int i = 0; i < _segments.size(); i++) {
+                for (unsigned int e = 0; e < 2; e++) {
+                    auto id = _edges[2*i + e];
+                    if (ends[0].count(id)) {ends[1][id] = i;}
+                    else {ends[0][id] = i;}
+                }
+            }
+            auto other = [&] (std::uint64_t id_, unsigned int from_) -> int {
+                auto a = ends[0].find(id_);
+                if (a != ends[0].end() and a->second != from_) {return a->second;}
+                auto b = ends[1].find(id_);
+                if (b != ends[1].end() and b->second != from_) {return b->second;}
+                return -1;
+            };
+            auto point = [&] (unsigned int seg_, unsigned int end_) {return end_ == 0 ? _segments[seg_].a : _segments[seg_].b;};
+
+            std::vector<bool> used(_segments.size(), false);
+            std::vector<std::vector<rs::Vector2<double>>> lines;
+            for (unsigned int start = 0; start < _segments.size(); start++) {
+                if (used[start]) {continue;}
+                // Walk back to an open end (if there is one) so each line is found whole
+                unsigned int seg = start;
+                unsigned int end = 0;
+                for (;;) {
+                    int prev = other(_edges[2*seg + end], seg);
+                    if (prev < 0 or prev == static_cast<int>(start)) {break;}
+                    end = _edges[2*prev] == _edges[2*seg + end] ? 1 : 0;
+                    seg = prev;
+                }
+                std::vector<rs::Vector2<double>> line {point(seg, end)};
+                for (;;) {
+                    used[seg] = true;
+                    const unsigned int exit = 1 - end;
+                    line.push_back(point(seg, exit));
+                    int next = other(_edges[2*seg + exit], seg);
+                    if (next < 0 or used[next]) {break;}
+                    end = _edges[2*next] == _edges[2*seg + exit] ? 0 : 1;
+                    seg = next;
+                }
+                lines.push_back(line);
+            }
+            return lines;
+        }
+        /**
+         * \brief Find the nearest outline along a ray
+         * \param origin_ Start of the ray
+         * \param angle_ Direction of the ray
+         * \param max_ Longest distance to check
+         * \return Distance to the nearest outline, or `max_` if there is none closer
+        */
+        double ray(rs::Vector2<double> origin_, double angle_, double max_) const {
+            rs::Vector2<double> d;
+            d.from_bearing(1.0, angle_);
+            return ray(origin_, d, max_);
+        }
+        /**
+         * \brief Find the nearest outline along a ray
+         * \param origin_ Start of the ray
+         * \param d Unit vector in the direction of the ray
+         * \param max_ Longest distance to check
+         * \return Distance to the nearest outline, or `max_` if there is none closer
+        */
+        double ray(rs::Vector2<double> origin_, rs::Vector2<double> d, double max_) const {
+            if (_nodes.empty()) {return max_;}
+            const rs::Vector2<double> inv(1.0/d.x, 1.0/d.y);
+            double nearest = max_;
+            unsigned int stack[64];
+            unsigned int top = 0;
+            stack[top++] = 0;
+            while (top > 0) {
+                const Node& node = _nodes[stack[--top]];
+                if (!hit_box(node, origin_, inv, nearest)) {continue;}
+                if (node.count == 0) {
+                    stack[top++] = node.right;
+                    stack[top++] = node.first;
+                    continue;
+                }
+                for (unsigned int i = node.first; i < node.first + node.count; i++) {
+                    const Segment& s = _segments[_order[i]];
+                    const rs::Vector2<double> e(s.b.x - s.a.x, s.b.y - s.a.y);
+                    const rs::Vector2<double> w(s.a.x - origin_.x, s.a.y - origin_.y);
+                    const double denom = d.x*e.y - d.y*e.x;
+                    if (denom == 0.0) {continue;}
+                    const double t = (w.x*e.y - w.y*e.x)/denom;
+                    const double u = (w.x*d.y - w.y*d.x)/denom;
+                    if (t >= 0.0 and t < nearest and u >= 0.0 and u <= 1.0) {nearest = t;}
+                }
+            }
+            return nearest;
+        }
+    };
     /**
      * \brief An environment with collision areas.
      * Based on Perlin noise
@@ -80,26 +559,195 @@ namespace stage {
         rs::Vector2<unsigned int> _sp;
 
         siv::PerlinNoise _noise;
+        siv::BasicPerlinNoise<float> _noise_f;
 
         unsigned int _octaves = 2;
         double _frequency = 6.0;
         double _threshold = 0.55;
+        NoiseKernel _kernel = LEGACY;
+        bool _single = false; // Sample `_noise_f` rather than `_noise`
+        double _scale; // Noise units per pixel
 
+        void update_scale() {
+            const unsigned int s = _win.x < _win.y ? _win.x : _win.y; // Use the smaller value
+            _scale = _frequency/s;
+        }
+
+        template <std::int32_t O, class Noise, class Float>
+        double octave(const Noise& noise_, Float x_, Float y_) const {
+            if (_kernel == FLAT) {return noise_.template flatOctave2D_01<O>(x_, y_);}
+            return noise_.template octave2D_01<O>(x_, y_);
+        }
+        template <class Noise, class Float>
+        double sample(const Noise& noise_, Float x_, Float y_) const {
+            // Common octave counts use kernels with the loop unrolled
+            switch (_octaves)
+            {
+            case 1: return octave<1>(noise_, x_, y_);
+            case 2: return octave<2>(noise_, x_, y_);
+            case 3: return octave<3>(noise_, x_, y_);
+            case 4: return octave<4>(noise_, x_, y_);
+            case 5: return octave<5>(noise_, x_, y_);
+            case 6: return octave<6>(noise_, x_, y_);
+            case 7: return octave<7>(noise_, x_, y_);
+            case 8: return octave<8>(noise_, x_, y_);
+            default:
+                if (_kernel == FLAT) {return noise_.flatOctave2D_01(x_, y_, _octaves);}
+                return noise_.octave2D_01(x_, y_, _octaves);
+            }
+        }
+        template <std::int32_t O, class Noise, class Float>
+        void octave_block(const Noise& noise_, const double* x_, const double* y_, std::size_t n_, double* v_) const {
+            if (_kernel == FLAT) {
+                for (std::size_t i = 0; i < n_; i++) {v_[i] = noise_.template flatOctave2D_01<O>(static_cast<Float>(x_[i]*_scale), static_cast<Float>(y_[i]*_scale));}
+            }
+            else {
+                for (std::size_t i = 0; i < n_; i++) {v_[i] = noise_.template octave2D_01<O>(static_cast<Float>(x_[i]*_scale), static_cast<Float>(y_[i]*_scale));}
+            }
+        }
+        template <class Noise, class Float>
+        void sample_block(const Noise& noise_, const double* x_, const double* y_, std::size_t n_, double* v_) const {
+            // As `sample()`, with the kernel chosen once for the whole block
+            switch (_octaves)
+            {
+            case 1: octave_block<1, Noise, Float>(noise_, x_, y_, n_, v_); break;
+            case 2: octave_block<2, Noise, Float>(noise_, x_, y_, n_, v_); break;
+            case 3: octave_block<3, Noise, Float>(noise_, x_, y_, n_, v_); break;
+            case 4: octave_block<4, Noise, Float>(noise_, x_, y_, n_, v_); break;
+            case 5: octave_block<5, Noise, Float>(noise_, x_, y_, n_, v_); break;
+            case 6: octave_block<6, Noise, Float>(noise_, x_, y_, n_, v_); break;
+            case 7: octave_block<7, Noise, Float>(noise_, x_, y_, n_, v_); break;
+            case 8: octave_block<8, Noise, Float>(noise_, x_, y_, n_, v_); break;
+            default:
+                for (std::size_t i = 0; i < n_; i++) {v_[i] = sample(noise_, static_cast<Float>(x_[i]*_scale), static_cast<Float>(y_[i]*_scale));}
+                break;
+            }
+        }
         const double trace_distance = 50.0; // Length of each ray
         const unsigned int cast_count = 32; // Number of rays cast
-        const unsigned int collision_points = 20; // Number of probes per ray
+        static constexpr unsigned int collision_points = 20; // Number of probes per ray
+        static_assert(collision_points <= 64, "Each ray's probes must fit one collision block");
+        const unsigned int exact_probe_block = 4; // Probes checked together without a lattice
         const unsigned int max_cast_iterations = 10000; // Number of casts before timeout
 
+        const double sweep_resolution = 0.5; // Smallest step taken along a swept path
+        const double clearance_margin = 1.5; // Allowance for the pixel spacing of the distance field
+
+        std::vector<float> _clearance; // Distance to the nearest collision pixel. Empty until baked
+
+        const double lattice_safety = 1.5; // Allowance for error between the points `approximate()` samples
+        const unsigned int lattice_error_step = 2; // Pixels between the error samples `approximate()` takes
+        unsigned int _spacing = 0; // Pixels between lattice points
+        rs::Vector2<unsigned int> _lattice_size;
+        std::vector<float> _lattice; // Noise sampled every `_spacing` pixels. Empty unless approximating
+        double _lattice_error = 0.0;
+
+        Contours _contours; // Empty until traced
+        bool _traced = false; // Set by `trace()`, even if no outlines were found
+
+        double interpolate(rs::Vector2<double> pos_) const {
+            const double gx = pos_.x/_spacing;
+            const double gy = pos_.y/_spacing;
+            const unsigned int ix = static_cast<unsigned int>(gx);
+            const unsigned int iy = static_cast<unsigned int>(gy);
+            const double fx = gx - ix;
+            const double fy = gy - iy;
+            const float* row0 = &_lattice[iy*_lattice_size.x + ix];
+            const float* row1 = row0 + _lattice_size.x;
+            const double top = row0[0] + (row0[1] - row0[0])*fx;
+            const double bottom = row1[0] + (row1[1] - row1[0])*fx;
+            return top + (bottom - top)*fy;
+        }
+
+        // Noise at up to 64 points
+        void value_block(const double* x_, const double* y_, std::size_t n_, double* v_) const {
+            if (_single) {sample_block<siv::BasicPerlinNoise<float>, float>(_noise_f, x_, y_, n_, v_);}
+            else {sample_block<siv::PerlinNoise, double>(_noise, x_, y_, n_, v_);}
+        }
+        /**
+         * \brief Check up to 64 points for collisions at once
+         * \return Bit `i` is set if point `i` is in a collision area
+        */
+        std::uint64_t collision_block(const double* x_, const double* y_, std::size_t n_) const {
+            double v[64];
+            std::uint64_t word = 0;
+            if (!_lattice.empty()) {
+                const double margin = _lattice_error*lattice_safety;
+                for (std::size_t i = 0; i < n_; i++) {
+                    // Clamped so out of bounds points can still be looked up (and are then ignored)
+                    const double x = std::clamp<double>(x_[i], 0.0, _win.x - 1);
+                    const double y = std::clamp<double>(y_[i], 0.0, _win.y - 1);
+                    v[i] = interpolate(rs::Vector2<double>(x, y));
+                }
+                for (std::size_t i = 0; i < n_; i++) {
+                    rs::Vector2<double> p(x_[i], y_[i]);
+                    if (!in_bounds(p) or v[i] < _threshold - margin) {continue;}
+                    if (v[i] > _threshold + margin or value(p) > _threshold) {word |= std::uint64_t(1) << i;}
+                }
+            }
+            else {
+                // Every point needs the exact noise, so it is sampled for the whole block together
+                value_block(x_, y_, n_, v);
+                for (std::size_t i = 0; i < n_; i++) {
+                    if (in_bounds(rs::Vector2<double>(x_[i], y_[i])) and v[i] > _threshold) {word |= std::uint64_t(1) << i;}
+                }
+            }
+            return word;
+        }
+
+        void invalidate() {
+            _contours = Contours();
+            _traced = false;
+            _clearance.clear();
+            _lattice.clear();
+            _lattice_error = 0.0;
+        }
+
+        static void distance_transform(std::vector<double>& f_) {
+            // Exact 1D squared euclidean distance transform
+            // (Felzenszwalb & Huttenlocher, lower envelope of parabolas)
+            const double inf = 1e20;
+            const unsigned int n = f_.size();
+            std::vector<double> d(n);
+            std::vector<unsigned int> v(n);
+            std::vector<double> z(n + 1);
+            unsigned int k = 0;
+            v[0] = 0;
+            z[0] = -inf;
+            z[1] = inf;
+            for (unsigned int q = 1; q < n; q++) {
+                double s;
+                for (;;) {
+                    s = ((f_[q] + double(q)*q) - (f_[v[k]] + double(v[k])*v[k])) / (2.0*q - 2.0*v[k]);
+                    if (s > z[k]) {break;}
+                    k--;
+                }
+                k++;
+                v[k] = q;
+                z[k] = s;
+                z[k+1] = inf;
+            }
+            k = 0;
+            for (unsigned int q = 0; q < n; q++) {
+                while (z[k+1] < q) {k++;}
+                d[q] = (double(q) - v[k])*(double(q) - v[k]) + f_[v[k]];
+            }
+            f_ = d;
+        }
+
         unsigned int fix_ray_index(unsigned int ri_) const {
             if (ri_ >= cast_count) {ri_-=cast_count;}
             return ri_;
         }
 
-        bool cast(rs::Vector2<double> pos_, unsigned int pri_, unsigned int& count) const {
+        bool cast(rs::Vector2<double> pos_, unsigned int pri_, unsigned int& count, const std::atomic<bool>* stop_) const {
             // Throw if max casts has been reach
             if (count > max_cast_iterations) {
                 throw std::runtime_error("Iteration limit reached");
             }
+            if (stop_ and stop_->load(std::memory_order_relaxed)) {
+                throw std::runtime_error("Cast stopped");
+            }
             count++;
 
             for (unsigned int i = 0; i < cast_count; i++) {
@@ -110,17 +758,31 @@ namespace stage {
                 ray_index = fix_ray_index(ray_index);
                 rs::Vector2<double> vect;
                 vect.from_bearing(trace_distance/collision_points, (2*pi*ray_index)/cast_count);
-                bool collides = false;
 
-                // Probe points along the ray
-                for (unsigned int p = 1; p <= collision_points; p++) {
-                    pos_.x += vect.x;
-                    pos_.y += vect.y;
-                    if (collision(pos_)) {collides = true; break;}
+                // Probe points along the ray, stopping at the first block with a collision.
+                // Lattice lookups are cheap, so the whole ray is one block
+                double px[64];
+                double py[64];
+                for (unsigned int p = 0; p < collision_points; p++) {
+                    px[p] = (p == 0 ? pos_.x : px[p-1]) + vect.x;
+                    py[p] = (p == 0 ? pos_.y : py[p-1]) + vect.y;
+                }
+                const unsigned int block = _lattice.empty() ? exact_probe_block : collision_points;
+                bool collides = false;
+                unsigned int last = collision_points - 1;
+                for (unsigned int first = 0; first < collision_points; first += block) {
+                    const unsigned int n = std::min(block, collision_points - first);
+                    const std::uint64_t hits = collision_block(px + first, py + first, n);
+                    if (hits) {
+                        collides = true;
+                        last = first + rs::lowest_bit(hits);
+                        break;
+                    }
                 }
+                pos_ = rs::Vector2<double>(px[last], py[last]);
                 if (!in_bounds(pos_)) {return true;} // Return true if the edge has been reached
                 if (!collides) {
-                    if (cast(pos_, ray_index, count)) {return true;} // Cast a new ray in an empty space
+                    if (cast(pos_, ray_index, count, stop_)) {return true;} // Cast a new ray in an empty space
                 }
             }
             return false;
@@ -132,7 +794,10 @@ namespace stage {
          * \return The amplitude of the noise at the given point
         */
         double value(rs::Vector2<double> pos_) const {
-            return value(pos_, _frequency, _octaves);
+            const double x = pos_.x * _scale;
+            const double y = pos_.y * _scale;
+            if (_single) {return sample(_noise_f, static_cast<float>(x), static_cast<float>(y));}
+            return sample(_noise, x, y);
         }
         /**
          * \param pos_ Point
@@ -144,6 +809,7 @@ namespace stage {
             const unsigned int s = _win.x < _win.y ? _win.x : _win.y; // Use the smaller value
             const double fx = f_/s;
             const double fy = f_/s;
+            if (_kernel == FLAT) {return _noise.flatOctave2D_01(pos_.x * fx, pos_.y * fy, o_);}
             return _noise.octave2D_01(pos_.x * fx, pos_.y * fy, o_);
         }
 
@@ -151,35 +817,366 @@ namespace stage {
 
         unsigned int seed;
 
-        Stage(rs::Vector2<unsigned int> win_) : _win(win_), _sp(win_.x/2, win_.y/2) {}
-        Stage(unsigned int winx_, unsigned int winy_) : _win(winx_, winy_), _sp(winx_/2, winy_/2) {}
+        Stage(rs::Vector2<unsigned int> win_) : _win(win_), _sp(win_.x/2, win_.y/2) {update_scale();}
+        Stage(unsigned int winx_, unsigned int winy_) : _win(winx_, winy_), _sp(winx_/2, winy_/2) {update_scale();}
 
         /**
          * \brief Set the number of octaves of noise.
          * Defaults to `2`
          * \param o_ New octave value
         */
-        void set_octaves(unsigned int o_) {_octaves = std::clamp<unsigned int>(o_, 1, 16);}
+        void set_octaves(unsigned int o_) {_octaves = std::clamp<unsigned int>(o_, 1, 16); invalidate();}
         /**
          * \brief Set the frequency of the noise.
          * Defaults to `4.0`
          * \param f_ New frequency value
         */
-        void set_frequency(double f_) {_frequency = std::clamp<double>(f_, 0.1, 64.0);}
+        void set_frequency(double f_) {_frequency = std::clamp<double>(f_, 0.1, 64.0); update_scale(); invalidate();}
         /**
          * \brief Set the threshold ("height" value) used for the map.
          * Defaults to `0.6`
          * \param t_ New threshold value
         */
-        void set_threshold(double t_) {_threshold = std::clamp<double>(t_, 0.0, 1.0);}
+        void set_threshold(double t_) {_threshold = std::clamp<double>(t_, 0.0, 1.0); _clearance.clear(); _contours = Contours(); _traced = false;}
+        /**
+         * \brief Set the noise function used for the map.
+         * Defaults to `LEGACY`, which keeps existing seeds valid
+         * \param k_ New noise kernel
+        */
+        void set_kernel(NoiseKernel k_) {_kernel = k_; invalidate();}
+        /**
+         * \brief If `true`, noise is sampled in single precision.
+         * Measured slower than double precision on x86-64, and collision
+         * areas may differ slightly at their edges.
+         * Defaults to `false`
+         * \param enable_
+        */
+        void single_precision(bool enable_) {_single = enable_; invalidate();}
         /**
          * \returns The threshold value for collisions
         */
-        double get_threshold() {return _threshold;}
+        double get_threshold() const {return _threshold;}
+        /**
+         * \returns The number of octaves of noise
+        */
+        unsigned int get_octaves() const {return _octaves;}
+        /**
+         * \returns The frequency of the noise
+        */
+        double get_frequency() const {return _frequency;}
+        /**
+         * \returns The noise function used for the map
+        */
+        NoiseKernel get_kernel() const {return _kernel;}
+        /**
+         * \returns `true` if noise is sampled in single precision
+        */
+        bool get_single_precision() const {return _single;}
         /**
          * \brief Generate new noise
         */
-        void generate() {_noise = siv::PerlinNoise(seed);}
+        void generate() {
+            _noise = siv::PerlinNoise(seed);
+            _noise_f.deserialize(_noise.serialize());
+            update_scale();
+            invalidate();
+        }
+        /**
+         * \brief Draw a new seed from a stream and generate new noise.
+         * The same stream always gives the same stage
+         * \param stream_ Stream to draw from, see `rng::STAGE`
+        */
+        void generate(rng::Stream& stream_) {
+            seed = stream_.next();
+            generate();
+        }
+        /**
+         * \brief Calculate the distance from every pixel to the nearest
+         * collision area. Speeds up `sweep()`.
+         * Must be called again after the stage has been changed
+        */
+        void bake() {
+            const double inf = 1e20;
+            std::vector<double> field(_win.x*_win.y);
+            for (unsigned int y = 0; y < _win.y; y++) {
+                for (unsigned int x = 0; x < _win.x; x++) {
+                    field[y*_win.x + x] = collision(rs::Vector2<double>(x, y)) ? 0.0 : inf;
+                }
+            }
+            // Transform columns, then rows
+            std::vector<double> line(_win.y);
+            for (unsigned int x = 0; x < _win.x; x++) {
+                for (unsigned int y = 0; y < _win.y; y++) {line[y] = field[y*_win.x + x];}
+                distance_transform(line);
+                for (unsigned int y = 0; y < _win.y; y++) {field[y*_win.x + x] = line[y];}
+            }
+            line.resize(_win.x);
+            _clearance.resize(_win.x*_win.y);
+            for (unsigned int y = 0; y < _win.y; y++) {
+                std::copy(field.begin() + y*_win.x, field.begin() + (y+1)*_win.x, line.begin());
+                distance_transform(line);
+                for (unsigned int x = 0; x < _win.x; x++) {_clearance[y*_win.x + x] = sqrt(line[x]);}
+            }
+        }
+        /**
+         * \brief Sample the noise on a coarse lattice and answer collision
+         * queries by bilinear interpolation. Points whose interpolated value
+         * is within `lattice_error()` (with a safety factor) of the threshold
+         * fall back to the exact noise. The error is measured every couple of
+         * pixels (at least at each cell's centre and edge midpoints), so it
+         * is an estimate rather than a bound.
+         * Must be called again after the stage has been changed
+         * \param spacing_ Pixels between lattice points. `0` turns the lattice off
+         * \return The estimated largest deviation from the exact noise, see `lattice_error()`
+        */
+        double approximate(unsigned int spacing_) {
+            // Only the lattice is replaced. Collisions are unchanged by it, so a
+            // distance field from `bake()` or outlines from `trace()` stay valid
+            _lattice.clear();
+            _lattice_size = rs::Vector2<unsigned int>(0, 0);
+            _lattice_error = 0.0;
+            _spacing = spacing_;
+            if (_spacing == 0) {return 0.0;}
+            // One extra point past each edge so every in-bounds pixel has 4 neighbours
+            _lattice_size = rs::Vector2<unsigned int>(_win.x/_spacing + 2, _win.y/_spacing + 2);
+            _lattice.resize(_lattice_size.x*_lattice_size.y);
+            for (unsigned int y = 0; y < _lattice_size.y; y++) {
+                for (unsigned int x = 0; x < _lattice_size.x; x++) {
+                    _lattice[y*_lattice_size.x + x] = value(rs::Vector2<double>(x*_spacing, y*_spacing));
+                }
+            }
+            // The worst point of a cell is not known (the cross term of the fit
+            // vanishes mid-cell, finer octaves peak anywhere), so each cell is
+            // sampled on a grid that includes its centre and edge midpoints.
+            // The right and bottom edges are sampled by the next cell along
+            unsigned int samples = std::max(2u, _spacing/lattice_error_step);
+            samples += samples%2; // Even, so the centre and edge midpoints are on the grid
+            const double step = double(_spacing)/samples;
+            double error = 0.0;
+            for (unsigned int y = 0; y + 1 < _lattice_size.y; y++) {
+                for (unsigned int x = 0; x + 1 < _lattice_size.x; x++) {
+                    for (unsigned int j = 0; j < samples; j++) {
+                        for (unsigned int i = 0; i < samples; i++) {
+                            if (i == 0 and j == 0) {continue;} // Lattice points are exact
+                            rs::Vector2<double> p(x*_spacing + i*step, y*_spacing + j*step);
+                            if (!in_bounds(p)) {continue;}
+                            error = std::max(error, std::abs(interpolate(p) - value(p)));
+                        }
+                    }
+                }
+            }
+            _lattice_error = error;
+            return _lattice_error;
+        }
+        /**
+         * \return The largest deviation between the lattice and the exact
+         * noise found by `approximate()`. An estimate, as only a grid of points
+         * in each cell is checked. `0.0` if not approximating
+        */
+        double lattice_error() const {return _lattice_error;}
+        /**
+         * \brief Trace the outlines of the collision areas with marching
+         * squares, so `ray()` can find them exactly.
+         * Must be called again after the stage has been changed
+         * \param spacing_ Distance in pixels between noise samples
+        */
+        void trace(double spacing_ = 1.0) {
+            const unsigned int nx = static_cast<unsigned int>(ceil(_win.x/spacing_)) + 1;
+            const unsigned int ny = static_cast<unsigned int>(ceil(_win.y/spacing_)) + 1;
+            std::vector<double> samples(nx*ny);
+            for (unsigned int y = 0; y < ny; y++) {
+                for (unsigned int x = 0; x < nx; x++) {
+                    samples[y*nx + x] = value(rs::Vector2<double>(x*spacing_, y*spacing_));
+                }
+            }
+            _contours = Contours(samples, nx, ny, spacing_, _threshold);
+            _traced = true;
+        }
+        /**
+         * \return `true` if `trace()` has been called since the stage last changed
+        */
+        bool traced() const {return _traced;}
+        /**
+         * \return The outlines of the collision areas. Empty until `trace()` is called
+        */
+        const Contours& contours() const {return _contours;}
+        /**
+         * \brief Requires `trace()`
+         * \param origin_ Start of the ray
+         * \param angle_ Direction of the ray
+         * \param max_ Longest distance to check
+         * \return Distance to the nearest collision area outline, or `max_` if there is none closer
+        */
+        double ray(rs::Vector2<double> origin_, double angle_, double max_) const {
+            return _contours.ray(origin_, angle_, max_);
+        }
+        /**
+         * \brief Requires `trace()`
+         * \param origin_ Start of the ray
+         * \param dir_ Unit vector in the direction of the ray
+         * \param max_ Longest distance to check
+         * \return Distance to the nearest collision area outline, or `max_` if there is none closer
+        */
+        double ray(rs::Vector2<double> origin_, rs::Vector2<double> dir_, double max_) const {
+            return _contours.ray(origin_, dir_, max_);
+        }
+        /**
+         * \brief The distance a sonar would measure along a ray.
+         * Uses the traced outlines if available, otherwise probes along the
+         * ray until a collision area or `max_` is reached.
+         * Probes are `resolution_` apart, and the reading is the distance of
+         * the first probe in a collision area. With a `stride_` of `1` every
+         * probe is tested. A larger stride tests every `stride_`th probe
+         * until one collides, then tests the probes it skipped to find the
+         * first. The reading is the same unless a collision area is crossed
+         * entirely between two tested probes, so only areas narrower than
+         * `stride_*resolution_` along the ray can be missed
+         * \param origin_ Start of the ray
+         * \param angle_ Direction of the ray
+         * \param resolution_ Distance between probes
+         * \param max_ Longest distance that can be measured
+         * \param stride_ Probes skipped by the coarse pass
+         * \return The distance to the first collision area
+        */
+        double sonar_distance(rs::Vector2<double> origin_, double angle_, double resolution_, double max_, unsigned int stride_ = 1) const {
+            rs::Vector2<double> dir;
+            dir.from_bearing(1.0, angle_);
+            return sonar_distance(origin_, dir, resolution_, max_, stride_);
+        }
+        /**
+         * \brief The distance a sonar would measure along a ray.
+         * See `sonar_distance(rs::Vector2<double>, double, double, double, unsigned int)`
+         * \param origin_ Start of the ray
+         * \param dir_ Unit vector in the direction of the ray
+         * \param resolution_ Distance between probes
+         * \param max_ Longest distance that can be measured
+         * \param stride_ Probes skipped by the coarse pass
+         * \return The distance to the first collision area
+        */
+        double sonar_distance(rs::Vector2<double> origin_, rs::Vector2<double> dir_, double resolution_, double max_, unsigned int stride_ = 1) const {
+            // Exact intersection with the traced outlines
+            if (traced()) {
+                if (collision(origin_)) {return 0.0;}
+                return ray(origin_, dir_, max_);
+            }
+            if (resolution_ <= 0.0) {throw std::runtime_error("Sonar resolution must be positive");}
+            if (stride_ == 0) {stride_ = 1;}
+            // Probes 0 to `probes - 1` are tested, reaching past them reads `max_`
+            const unsigned int probes = static_cast<unsigned int>(ceil(max_/resolution_ - 1e-9));
+            if (probes == 0) {return max_;}
+            // Tests probes `first_`, `first_ + step_`, ... up to `last_` in blocks,
+            // setting `hit_` to the first that collides
+            auto scan = [&] (unsigned int first_, unsigned int step_, unsigned int last_, unsigned int& hit_) {
+                const std::size_t block = 16;
+                double x[block];
+                double y[block];
+                for (unsigned int i = first_; i <= last_; ) {
+                    std::size_t n = 0;
+                    for (; n < block and i <= last_; n++, i += step_) {
+                        const double d = i*resolution_;
+                        x[n] = origin_.x + dir_.x*d;
+                        y[n] = origin_.y + dir_.y*d;
+                    }
+                    const std::uint64_t hits = collision_block(x, y, n);
+                    if (hits) {
+                        hit_ = i - static_cast<unsigned int>(n - rs::lowest_bit(hits))*step_;
+                        return true;
+                    }
+                }
+                return false;
+            };
+            // Coarse pass, which always includes the first and last probes
+            unsigned int hit = 0;
+            bool found = scan(0, stride_, probes - 1, hit);
+            if (!found and (probes - 1) % stride_ != 0) {found = scan(probes - 1, 1, probes - 1, hit);}
+            if (!found) {return max_;}
+            if (hit == 0) {return 0.0;}
+            // Fine pass over the probes skipped before the hit
+            const unsigned int clear = ((hit - 1)/stride_)*stride_;
+            unsigned int fine = 0;
+            if (clear + 1 < hit and scan(clear + 1, 1, hit - 1, fine)) {return fine*resolution_;}
+            return hit*resolution_;
+        }
+        /**
+         * \brief The distance to the nearest collision area inside a cone,
+         * found by marching the cone through the distance field.
+         * Falls back to `sonar_distance()` if the stage has not been baked
+         * \param origin_ Tip of the cone
+         * \param angle_ Direction of the cone's axis
+         * \param half_width_ Angle between the axis and the edge of the cone
+         * \param max_ Longest distance that can be measured
+         * \return The distance to the first collision area in the cone
+        */
+        double cone_distance(rs::Vector2<double> origin_, double angle_, double half_width_, double max_) const {
+            if (!baked()) {return sonar_distance(origin_, angle_, sweep_resolution, max_);}
+            if (collision(origin_)) {return 0.0;}
+            rs::Vector2<double> dir;
+            dir.from_bearing(1.0, angle_);
+            const double k = sin(std::clamp(half_width_, 0.0, pi/2)); // Growth of the disc inscribed in the cone
+            double t = 0.0;
+            while (t < max_) {
+                rs::Vector2<double> p(origin_.x + dir.x*t, origin_.y + dir.y*t);
+                const double c = clearance(p);
+                // Something lies within the cone's cross-section, allowing for the field's margin
+                if (c + clearance_margin <= t*k + sweep_resolution) {
+                    // The obstacle lies down the field's gradient from the disc's centre
+                    rs::Vector2<double> g(clearance(rs::Vector2<double>(p.x + 1, p.y)) - clearance(rs::Vector2<double>(p.x - 1, p.y)),
+                                          clearance(rs::Vector2<double>(p.x, p.y + 1)) - clearance(rs::Vector2<double>(p.x, p.y - 1)));
+                    const double len = sqrt(g.x*g.x + g.y*g.y);
+                    if (len == 0.0) {return t;}
+                    const double reach = (c + clearance_margin)/len;
+                    rs::Vector2<double> q(p.x - g.x*reach - origin_.x, p.y - g.y*reach - origin_.y);
+                    return std::min(sqrt(q.x*q.x + q.y*q.y), max_);
+                }
+                // Largest step that keeps the next inscribed disc inside the clear disc
+                t += std::max((c - t*k)/(1 + k), sweep_resolution);
+            }
+            return max_;
+        }
+        /**
+         * \return `true` if `bake()` has been called since the stage last changed
+        */
+        bool baked() const {return !_clearance.empty();}
+        /**
+         * \brief A lower bound on the distance from a point to the nearest
+         * collision area. Always `0.0` if the stage has not been baked
+         * \param pos_ The point to check
+         * \return The clearance in pixels
+        */
+        double clearance(rs::Vector2<double> pos_) const {
+            if (!baked()) {return 0.0;}
+            // Points outside the stage use the nearest point inside it
+            rs::Vector2<double> edge(std::clamp<double>(pos_.x, 0.0, _win.x - 1), std::clamp<double>(pos_.y, 0.0, _win.y - 1));
+            const double outside = sqrt((pos_.x - edge.x)*(pos_.x - edge.x) + (pos_.y - edge.y)*(pos_.y - edge.y));
+            unsigned int x = static_cast<unsigned int>(edge.x + 0.5);
+            unsigned int y = static_cast<unsigned int>(edge.y + 0.5);
+            if (x >= _win.x) {x = _win.x - 1;}
+            if (y >= _win.y) {y = _win.y - 1;}
+            double c = std::max(_clearance[y*_win.x + x] - clearance_margin - outside, outside);
+            return c > 0.0 ? c : 0.0;
+        }
+        /**
+         * \brief Check a straight path for collisions.
+         * Probes are spaced by the clearance of each point (conservative
+         * advancement) and never further apart than `sweep_resolution`
+         * \param from_ Start of the path
+         * \param to_ End of the path
+         * \param toi_ Set to the fraction of the path travelled before the first collision
+         * \return `true` if the path enters a collision area
+        */
+        bool sweep(rs::Vector2<double> from_, rs::Vector2<double> to_, double& toi_) const {
+            const double dx = to_.x - from_.x;
+            const double dy = to_.y - from_.y;
+            const double length = sqrt(dx*dx + dy*dy);
+            double travelled = 0.0;
+            for (;;) {
+                double t = length > 0.0 ? travelled/length : 1.0;
+                rs::Vector2<double> probe(from_.x + dx*t, from_.y + dy*t);
+                if (collision(probe)) {toi_ = t; return true;}
+                if (travelled >= length) {return false;}
+                travelled = std::min(length, travelled + std::max(clearance(probe), sweep_resolution));
+            }
+        }
         /**
          * \brief Check a point lies inside a collision area
          * \param pos_ The point to check
@@ -187,8 +1184,32 @@ namespace stage {
         */
         bool collision(rs::Vector2<double> pos_) const {
             if (!in_bounds(pos_)) {return false;} // Credit Michael
+            if (!_lattice.empty()) {
+                // Only points close to the threshold need the exact value
+                const double margin = _lattice_error*lattice_safety;
+                const double v = interpolate(pos_);
+                if (v > _threshold + margin) {return true;}
+                if (v < _threshold - margin) {return false;}
+            }
             return value(pos_) > _threshold;
             }
+        /**
+         * \brief Check many points for collisions at once.
+         * Points are checked in blocks of 64 with one pass over the noise (or the
+         * lattice, see `approximate()`) per block, so the kernel is picked once
+         * per block rather than once per point
+         * \param x_ The x coordinate of each point
+         * \param y_ The y coordinate of each point. Must be the same size as `x_`
+         * \param mask_ Bit `i % 64` of word `i / 64` is set if point `i` is in a collision area
+        */
+        void collision(rs::Span<const double> x_, rs::Span<const double> y_, std::vector<std::uint64_t>& mask_) const {
+            if (x_.size() != y_.size()) {throw std::invalid_argument("Coordinate spans differ in size");}
+            const std::size_t n = x_.size();
+            mask_.assign((n + 63)/64, 0);
+            for (std::size_t base = 0; base < n; base += 64) {
+                mask_[base/64] = collision_block(&x_[base], &y_[base], std::min<std::size_t>(64, n - base));
+            }
+        }
         /**
          * \brief Check a point lies inside the stage confines
          * \param pos_ The point to check
@@ -197,14 +1218,16 @@ namespace stage {
         bool in_bounds(rs::Vector2<double> pos_) const {return (pos_.x >= 0 and pos_.y >= 0 and pos_.x < _win.x and pos_.y < _win.y);}
         /**
          * \brief Check if the stage can be navigated
+         * \param stop_ If given, the check gives up (and returns `false`)
+         * as soon as this is set, so another thread can abandon it
          * \return `true` if the stage is possible
         */
-        bool possible() const {
+        bool possible(const std::atomic<bool>* stop_ = nullptr) const {
             if (collision(_sp)) {return false;}
             unsigned int iteration = 0;
             bool possible = false;
             try {
-                possible = cast(_sp, cast_count, iteration);
+                possible = cast(_sp, cast_count, iteration, stop_);
             }
             catch (std::runtime_error const&) {
                 possible = false;
@@ -221,53 +1244,275 @@ namespace stage {
         rs::Vector2<unsigned int> window_size() const {return _win;}
     };
     /**
-     * \brief A stage that can be drawn to an sf::RenderWindow
+     * \brief Precomputed sonar readings for a stage.
+     * Stores the reading from the centre of every cell in a grid, for a
+     * number of evenly spaced headings, so a reading is a table lookup.
+     * Can be saved and memory-mapped back from a file
     */
-    class DisplayedStage : public Stage {
+    class SonarTable {
         private:
-        sf::Texture _t_collision;
-        sf::Texture _t_possible;
-        sf::RenderWindow& _window;
+        static constexpr char magic[8] = {'P','C','M','P','S','O','N','R'};
+        static const std::uint32_t version = 2;
+        static const std::size_t header_size = 68;
 
-        sf::Sprite from_image(sf::Image image_) const {
-            sf::Texture t;
-            t.loadFromImage(image_);
-            sf::Sprite s(t);
-            return s;
+        unsigned int _cell = 0;
+        unsigned int _headings = 0;
+        rs::Vector2<unsigned int> _cells;
+        rs::Vector2<unsigned int> _win;
+        double _range = 0.0;
+
+        // Settings of the stage the table was made for
+        unsigned int _seed = 0;
+        unsigned int _octaves = 0;
+        unsigned int _kernel = 0;
+        unsigned int _single = 0;
+        double _frequency = 0.0;
+        double _threshold = 0.0;
+
+        void take_settings(const Stage& stage_) {
+            _seed = stage_.seed;
+            _octaves = stage_.get_octaves();
+            _kernel = stage_.get_kernel();
+            _single = stage_.get_single_precision();
+            _frequency = stage_.get_frequency();
+            _threshold = stage_.get_threshold();
         }
-        void centre(sf::Sprite& s_) const {
-            auto t_size = s_.getTexture()->getSize();
-            s_.setOrigin(sf::Vector2f((t_size.x/2),(t_size.y/2)));
+        bool same_settings(const Stage& stage_) const {
+            return _seed == stage_.seed and _octaves == stage_.get_octaves() and _kernel == unsigned(stage_.get_kernel())
+                and _single == unsigned(stage_.get_single_precision()) and _frequency == stage_.get_frequency() and _threshold == stage_.get_threshold();
         }
-        sf::Image collision_boundaries() const {
-            // Create image
-            sf::Image image;
-            auto win = window_size();
-            image.create(win.x, win.y, sf::Color::White);
-            for (unsigned int x = 0; x < win.x; x++) {
-                for (unsigned int y = 0; y < win.y; y++) {
-                    unsigned int pv = 255;
-                    rs::Vector2<double> point(x,y);
-                    if (collision(point)) {
-                        image.setPixel(x,y,sf::Color(pv,0,0,255));
-                    }
-                }
-            }
-            // Create sprite from image
-            return image;
+        bool _interpolate = true;
+        double _build_seconds = 0.0;
+
+        std::vector<std::uint16_t> _owned; // Used when built
+        const std::uint16_t* _data = nullptr; // Either `_owned` or the mapped file
+
+        rs::MappedFile _file; // Set by `map()`
+
+        void unmap() {_file.close();}
+
+        double entry(unsigned int cx_, unsigned int cy_, unsigned int h_) const {
+            return _data[(std::size_t(cy_)*_cells.x + cx_)*_headings + h_]*(_range/65535.0);
         }
 
         public:
-        DisplayedStage(rs::Vector2<unsigned int> win_, sf::RenderWindow& window_) : Stage(win_), _window(window_) {}
-        DisplayedStage(unsigned int x_, unsigned int y_, sf::RenderWindow& window_) : Stage(x_, y_), _window(window_) {}
+        SonarTable() {}
+        SonarTable(const SonarTable&) = delete;
+        SonarTable& operator=(const SonarTable&) = delete;
+        ~SonarTable() {unmap();}
         /**
-         * \brief Calculate the textures of non-constant sprites.
-         * Should be called when changes have been made to the stage
-         * (such a seed change)
+         * \brief Calculate the table using every available thread
+         * \param stage_ The stage to take readings from
+         * \param cell_ Size of each grid cell in pixels
+         * \param headings_ Number of evenly spaced headings per cell
+         * \param resolution_ Distance between probes, see `bot::Sonar::resolution()`
+         * \param range_ Longest reading, see `bot::Sonar::range()`
         */
-        void render() {
+        void build(const Stage& stage_, unsigned int cell_, unsigned int headings_, double resolution_, double range_) {
+            auto start = std::chrono::steady_clock::now();
+            unmap();
+            _cell = std::max(1u, cell_);
+            _headings = std::max(1u, headings_);
+            _win = stage_.window_size();
+            _cells = rs::Vector2<unsigned int>((_win.x + _cell - 1)/_cell, (_win.y + _cell - 1)/_cell);
+            take_settings(stage_);
+            _range = range_;
+            _owned.assign(std::size_t(_cells.x)*_cells.y*_headings, 0);
+
+            std::vector<double> bearings(_headings);
+            for (unsigned int h = 0; h < _headings; h++) {bearings[h] = (2*pi*h)/_headings;}
+            rs::Vectors2<double> directions;
+            directions.from_bearings(1.0, rs::Span<const double>(bearings.data(), bearings.size()));
+
+            // Rows are shared out between threads
+            auto fill_rows = [&] (unsigned int first_, unsigned int step_) {
+                for (unsigned int cy = first_; cy < _cells.y; cy += step_) {
+                    for (unsigned int cx = 0; cx < _cells.x; cx++) {
+                        rs::Vector2<double> centre((cx + 0.5)*_cell, (cy + 0.5)*_cell);
+                        for (unsigned int h = 0; h < _headings; h++) {
+                            double d = stage_.sonar_distance(centre, directions[h], resolution_, range_);
+                            d = std::clamp(d, 0.0, range_);
+                            _owned[(std::size_t(cy)*_cells.x + cx)*_headings + h] = static_cast<std::uint16_t>(lround((d/range_)*65535.0));
+                        }
+                    }
+                }
+            };
+            unsigned int thread_count = std::max(1u, std::thread::hardware_concurrency());
+            std::vector<std::thread> threads;
+            for (unsigned int t = 0; t < thread_count; t++) {threads.emplace_back(fill_rows, t, thread_count);}
+            for (auto& t : threads) {t.join();}
+
+            _data = _owned.data();
+            _build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        /**
+         * \brief Write the table to a file, to be loaded with `map()`
+         * \param path_ File to write
+        */
+        void save(const std::string& path_) const {
+            if (_data == nullptr) {throw std::runtime_error("Sonar table has not been built");}
+            std::ofstream file(path_, std::ofstream::binary);
+            if (!file.good()) {throw std::runtime_error("Unable to write sonar table");}
+            std::uint32_t fields[9] = {version, _win.x, _win.y, _cell, _headings, _seed, _octaves, _kernel, _single};
+            double values[3] = {_range, _frequency, _threshold};
+            file.write(magic, sizeof(magic));
+            file.write(reinterpret_cast<const char*>(fields), sizeof(fields));
+            file.write(reinterpret_cast<const char*>(values), sizeof(values));
+            file.write(reinterpret_cast<const char*>(_data), entries()*sizeof(std::uint16_t));
+        }
+        /**
+         * \brief Memory-map a table written by `save()`.
+         * Only the pages that are read are loaded
+         * \param path_ File to map
+         * \param stage_ The stage the table must belong to. Its size, seed
+         * and noise settings must match the stage the table was built for
+        */
+        void map(const std::string& path_, const Stage& stage_) {
+            auto start = std::chrono::steady_clock::now();
+            unmap();
+            _owned.clear();
+            _data = nullptr;
+            if (!_file.open(path_)) {throw std::runtime_error("Unable to map sonar table");}
+
+            const char* bytes = _file.data();
+            std::uint32_t fields[9];
+            double values[3];
+            if (_file.size() < header_size or std::memcmp(bytes, magic, sizeof(magic)) != 0) {
+                unmap();
+                throw std::runtime_error("Not a sonar table");
+            }
+            std::memcpy(fields, bytes + sizeof(magic), sizeof(fields));
+            std::memcpy(values, bytes + sizeof(magic) + sizeof(fields), sizeof(values));
+            if (fields[0] != version) {
+                unmap();
+                throw std::runtime_error("Unsupported sonar table version");
+            }
+            _win = rs::Vector2<unsigned int>(fields[1], fields[2]);
+            _cell = fields[3];
+            _headings = fields[4];
+            _seed = fields[5];
+            _octaves = fields[6];
+            _kernel = fields[7];
+            _single = fields[8];
+            _range = values[0];
+            _frequency = values[1];
+            _threshold = values[2];
+            if (_cell == 0 or _headings == 0 or !(_range > 0.0)) {
+                unmap();
+                throw std::runtime_error("Sonar table is corrupt");
+            }
+
+            auto win = stage_.window_size();
+            if (_win.x != win.x or _win.y != win.y or !same_settings(stage_)) {
+                unmap();
+                throw std::runtime_error("Sonar table does not match the stage");
+            }
+            _cells = rs::Vector2<unsigned int>((_win.x + _cell - 1)/_cell, (_win.y + _cell - 1)/_cell);
+            if (_file.size() < header_size + entries()*sizeof(std::uint16_t)) {
+                unmap();
+                throw std::runtime_error("Sonar table is incomplete");
+            }
+            _data = reinterpret_cast<const std::uint16_t*>(bytes + header_size);
+            _build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        /**
+         * \brief If `true`, readings are interpolated between the two
+         * nearest headings. Defaults to `true`
+         * \param enable_
+        */
+        void interpolate(bool enable_) {_interpolate = enable_;}
+        /**
+         * \brief Requires `build()` or `map()`
+         * \param pos_ Position and heading of the sonar
+         * \return The reading from the centre of the cell containing the position
+        */
+        double distance(rs::Position pos_) const {
+            const unsigned int cx = std::min<unsigned int>(std::max(pos_.position.x, 0.0)/_cell, _cells.x - 1);
+            const unsigned int cy = std::min<unsigned int>(std::max(pos_.position.y, 0.0)/_cell, _cells.y - 1);
+            const double h = (radians::wrap(pos_.rotation)*_headings)/(2*pi);
+            const unsigned int h0 = static_cast<unsigned int>(h) % _headings;
+            if (!_interpolate) {
+                return entry(cx, cy, static_cast<unsigned int>(lround(h)) % _headings);
+            }
+            const unsigned int h1 = (h0 + 1) % _headings;
+            const double t = h - floor(h);
+            return entry(cx, cy, h0)*(1 - t) + entry(cx, cy, h1)*t;
+        }
+        /**
+         * \return The number of stored readings
+        */
+        std::size_t entries() const {return std::size_t(_cells.x)*_cells.y*_headings;}
+        /**
+         * \return Memory used by the readings in bytes
+        */
+        std::size_t bytes() const {return entries()*sizeof(std::uint16_t);}
+        /**
+         * \return Time in seconds the last `build()` or `map()` took
+        */
+        double build_seconds() const {return _build_seconds;}
+        /**
+         * \return Number of headings stored for each cell
+        */
+        unsigned int headings() const {return _headings;}
+    };
+    /**
+     * \brief A stage that can be drawn to an sf::RenderWindow
+    */
+    class DisplayedStage : public Stage {
+        private:
+        sf::Texture _t_collision;
+        const assets::Region* _possible = &evaluation::possible;
+        sf::RenderWindow& _window;
+
+        mutable text::Batch _axis_labels;
+        mutable text::Batch _seed_label;
+        mutable unsigned int _label_seed = 0; // Seed `_seed_label` was made for
+
+        sf::Sprite from_image(sf::Image image_) const {
+            sf::Texture t;
+            t.loadFromImage(image_);
+            sf::Sprite s(t);
+            return s;
+        }
+        void centre(sf::Sprite& s_) const {
+            auto t_rect = s_.getTextureRect();
+            s_.setOrigin(sf::Vector2f((t_rect.width/2),(t_rect.height/2)));
+        }
+        sf::Image collision_boundaries() const {
+            // Create image
+            sf::Image image;
+            auto win = window_size();
+            image.create(win.x, win.y, sf::Color::White);
+            // Query a row at a time
+            std::vector<double> xs(win.x);
+            std::vector<double> ys(win.x);
+            std::vector<std::uint64_t> mask;
+            for (unsigned int x = 0; x < win.x; x++) {xs[x] = x;}
+            for (unsigned int y = 0; y < win.y; y++) {
+                std::fill(ys.begin(), ys.end(), y);
+                collision(rs::Span<const double>(xs.data(), win.x), rs::Span<const double>(ys.data(), win.x), mask);
+                for (unsigned int x = 0; x < win.x; x++) {
+                    unsigned int pv = 255;
+                    if ((mask[x/64] >> (x%64)) & 1) {
+                        image.setPixel(x,y,sf::Color(pv,0,0,255));
+                    }
+                }
+            }
+            // Create sprite from image
+            return image;
+        }
+
+        public:
+        DisplayedStage(rs::Vector2<unsigned int> win_, sf::RenderWindow& window_) : Stage(win_), _window(window_), _axis_labels(16), _seed_label(16) {}
+        DisplayedStage(unsigned int x_, unsigned int y_, sf::RenderWindow& window_) : Stage(x_, y_), _window(window_), _axis_labels(16), _seed_label(16) {}
+        /**
+         * \brief Calculate the textures of non-constant sprites.
+         * Should be called when changes have been made to the stage
+         * (such a seed change)
+        */
+        void render() {
             _t_collision.loadFromImage(collision_boundaries());
-            _t_possible = possible() ? evaluation::possible : evaluation::possible;
+            _possible = possible() ? &evaluation::possible : &evaluation::possible;
         }
         enum POI {
             COLLISION,
@@ -285,8 +1530,6 @@ namespace stage {
             auto sp = spawn_point();
 
             sf::Sprite sprite;
-            sf::Text text;
-            sf::Texture t;
             switch (poi_)
             {
             case COLLISION :
@@ -295,40 +1538,34 @@ namespace stage {
                 break;
 
             case SPAWNPOINT :
-                sprite.setTexture(spawnpoint);
+                spawnpoint.apply(sprite);
                 centre(sprite);
                 sprite.setPosition(sf::Vector2f(sp.x, sp.y));
                 _window.draw(sprite);
                 break;
             
             case POSSIBLE :
-                sprite.setTexture(_t_possible);
+                _possible->apply(sprite);
                 sprite.setPosition(win.x/50, win.y/50);
                 _window.draw(sprite);
                 break;
 
             case AXIS :
-                text.setFont(assets::fonts::arial);
-                text.setCharacterSize(16);
-
-                text.setString("x");
-                text.setFillColor(sf::Color(180,0,0,255));
-                text.setPosition(sf::Vector2f(win.x/2, win.y/500));
-                _window.draw(text);
-
-                text.setString("y");
-                text.setFillColor(sf::Color(0,180,0,255));
-                text.setPosition(sf::Vector2f(win.x/500, win.y/2));
-                _window.draw(text);
+                // The labels never change, so are laid out once
+                if (_axis_labels.empty()) {
+                    _axis_labels.add("x", sf::Vector2f(win.x/2, win.y/500), sf::Color(180,0,0,255));
+                    _axis_labels.add("y", sf::Vector2f(win.x/500, win.y/2), sf::Color(0,180,0,255));
+                }
+                _window.draw(_axis_labels);
                 break;
             
             case SEED :
-                text.setFont(assets::fonts::arial);
-                text.setCharacterSize(16);
-                text.setString("Seed: " + std::to_string(seed));
-                text.setFillColor(sf::Color(10,10,10,255));
-                text.setPosition(sf::Vector2f(win.x/50, win.y/500));
-                _window.draw(text);
+                if (_seed_label.empty() or _label_seed != seed) {
+                    _seed_label.clear();
+                    _seed_label.add("Seed: " + std::to_string(seed), sf::Vector2f(win.x/50, win.y/500), sf::Color(10,10,10,255));
+                    _label_seed = seed;
+                }
+                _window.draw(_seed_label);
                 break;
 
             default:
@@ -337,6 +1574,227 @@ namespace stage {
             }
         }
     };
+    /**
+     * \brief Shows the collision areas of a stage while its noise settings
+     * are tuned. A coarse preview is made straight away, then finer ones
+     * are worked out on other threads, halving the sample spacing each
+     * time. Changing the settings again abandons the work on the old ones
+    */
+    class StagePreview {
+        public:
+        enum Evaluation {
+            UNKNOWN, // Still being worked out
+            POSSIBLE,
+            IMPOSSIBLE
+        };
+
+        private:
+        static const unsigned int coarsest = 16; // Pixels per sample of the first preview
+
+        const Stage& _stage;
+        rs::Vector2<unsigned int> _win;
+
+        // Shared with the workers, guarded by `_mutex`
+        std::mutex _mutex;
+        std::condition_variable _changed;
+        std::vector<std::thread> _threads;
+        std::shared_ptr<const Stage> _settings; // Copy of the stage being refined
+        unsigned long long _generation = 0; // Increased by every `update()`
+        unsigned int _scale = 0; // Pixels per sample of the level being refined, `0` when finished
+        rs::Vector2<unsigned int> _size; // Samples across and down the level being refined
+        unsigned int _next_row = 0;
+        unsigned int _rows_done = 0;
+        std::vector<std::uint8_t> _pixels; // RGBA of the level being refined
+        bool _evaluate = false; // `possible()` has still to be run
+        std::shared_ptr<std::atomic<bool>> _stale; // Set to abandon the running `possible()`
+        bool _closing = false;
+
+        // Finished levels waiting for `poll()`, guarded by `_mutex`
+        std::vector<std::uint8_t> _ready;
+        rs::Vector2<unsigned int> _ready_size;
+        unsigned int _ready_scale = 0;
+        bool _fresh = false;
+        Evaluation _evaluation = UNKNOWN;
+
+        // Drawing thread only
+        sf::Texture _texture;
+        sf::Sprite _sprite;
+        rs::Vector2<unsigned int> _shown_size;
+        unsigned int _shown_scale = 0;
+
+        rs::Vector2<unsigned int> level_size(unsigned int scale_) const {
+            return rs::Vector2<unsigned int>((_win.x + scale_ - 1)/scale_, (_win.y + scale_ - 1)/scale_);
+        }
+        // Requires the lock
+        void start_level(unsigned int scale_) {
+            _scale = scale_;
+            _size = level_size(scale_);
+            _pixels.resize(std::size_t(_size.x)*_size.y*4);
+            _next_row = 0;
+            _rows_done = 0;
+        }
+        // Samples the middle of each block of pixels, so a scale of `1`
+        // matches `DisplayedStage::render()`
+        void fill_row(const Stage& stage_, unsigned int scale_, unsigned int row_, unsigned int width_, std::uint8_t* out_) const {
+            std::vector<double> xs(width_);
+            std::vector<double> ys(width_, std::min(row_*scale_ + scale_/2, _win.y - 1));
+            std::vector<std::uint64_t> mask;
+            for (unsigned int x = 0; x < width_; x++) {xs[x] = std::min(x*scale_ + scale_/2, _win.x - 1);}
+            stage_.collision(rs::Span<const double>(xs.data(), width_), rs::Span<const double>(ys.data(), width_), mask);
+            for (unsigned int x = 0; x < width_; x++) {
+                const bool hit = (mask[x/64] >> (x%64)) & 1;
+                out_[x*4] = 255;
+                out_[x*4 + 1] = hit ? 0 : 255;
+                out_[x*4 + 2] = hit ? 0 : 255;
+                out_[x*4 + 3] = 255;
+            }
+        }
+        void show(const std::vector<std::uint8_t>& pixels_, rs::Vector2<unsigned int> size_, unsigned int scale_) {
+            if (size_.x != _shown_size.x or size_.y != _shown_size.y) {
+                _texture.create(size_.x, size_.y);
+                _shown_size = size_;
+            }
+            _texture.update(pixels_.data());
+            _sprite.setTexture(_texture, true);
+            _sprite.setScale(scale_, scale_);
+            _shown_scale = scale_;
+        }
+        void work() {
+            std::vector<std::uint8_t> row;
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (true) {
+                _changed.wait(lock, [this] {return _closing or _evaluate or (_scale > 0 and _next_row < _size.y);});
+                if (_closing) {return;}
+                const unsigned long long generation = _generation;
+                std::shared_ptr<const Stage> settings = _settings;
+                std::shared_ptr<std::atomic<bool>> stale = _stale;
+                if (_scale > 0 and _next_row < _size.y) {
+                    // Refinement comes first, it is what is being looked at
+                    const unsigned int scale = _scale;
+                    const unsigned int y = _next_row++;
+                    const unsigned int width = _size.x;
+                    lock.unlock();
+                    row.resize(std::size_t(width)*4);
+                    fill_row(*settings, scale, y, width, row.data());
+                    lock.lock();
+                    if (generation != _generation) {continue;} // Settings have changed since
+                    std::copy(row.begin(), row.end(), _pixels.begin() + std::size_t(y)*width*4);
+                    if (++_rows_done == _size.y) {
+                        _ready = _pixels;
+                        _ready_size = _size;
+                        _ready_scale = scale;
+                        _fresh = true;
+                        if (scale > 1) {start_level(scale/2);}
+                        else {_scale = 0;}
+                        _changed.notify_all();
+                    }
+                }
+                else {
+                    _evaluate = false;
+                    lock.unlock();
+                    const bool possible = settings->possible(stale.get());
+                    lock.lock();
+                    if (generation == _generation) {_evaluation = possible ? POSSIBLE : IMPOSSIBLE;}
+                }
+            }
+        }
+
+        public:
+        /**
+         * \param stage_ The stage being tuned, which must outlive the preview
+         * \param threads_ Number of worker threads, `0` for one per core
+        */
+        StagePreview(const Stage& stage_, unsigned int threads_ = 0) :
+            _stage(stage_),
+            _win(stage_.window_size())
+        {
+            if (threads_ == 0) {threads_ = std::max(1u, std::thread::hardware_concurrency());}
+            for (unsigned int t = 0; t < threads_; t++) {_threads.emplace_back(&StagePreview::work, this);}
+        }
+        StagePreview(const StagePreview&) = delete;
+        StagePreview& operator=(const StagePreview&) = delete;
+        ~StagePreview() {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _closing = true;
+                if (_stale) {_stale->store(true);}
+            }
+            _changed.notify_all();
+            for (auto& t : _threads) {t.join();}
+        }
+        /**
+         * \brief Start previewing the stage's current settings. Call after
+         * changing them. The coarsest preview is made before returning,
+         * which takes 1/256 of the work of a full render
+        */
+        void update() {
+            std::shared_ptr<const Stage> settings = std::make_shared<const Stage>(_stage);
+            const rs::Vector2<unsigned int> size = level_size(coarsest);
+            std::vector<std::uint8_t> pixels(std::size_t(size.x)*size.y*4);
+            for (unsigned int y = 0; y < size.y; y++) {
+                fill_row(*settings, coarsest, y, size.x, &pixels[std::size_t(y)*size.x*4]);
+            }
+            show(pixels, size, coarsest);
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _generation++;
+                _settings = settings;
+                if (_stale) {_stale->store(true);}
+                _stale = std::make_shared<std::atomic<bool>>(false);
+                _evaluate = true;
+                _evaluation = UNKNOWN;
+                _fresh = false;
+                start_level(coarsest/2);
+            }
+            _changed.notify_all();
+        }
+        /**
+         * \brief Show the finest preview finished so far. Call once a frame
+         * \return `true` if the preview has changed
+        */
+        bool poll() {
+            std::vector<std::uint8_t> pixels;
+            rs::Vector2<unsigned int> size;
+            unsigned int scale;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!_fresh) {return false;}
+                _fresh = false;
+                pixels.swap(_ready);
+                size = _ready_size;
+                scale = _ready_scale;
+            }
+            show(pixels, size, scale);
+            return true;
+        }
+        /**
+         * \brief Draw the preview, and whether the stage is possible once known
+         * \param target_ Where to draw it
+        */
+        void draw(sf::RenderTarget& target_) {
+            if (_shown_scale == 0) {return;}
+            target_.draw(_sprite);
+            const Evaluation e = evaluation();
+            if (e != UNKNOWN) {
+                sf::Sprite sprite;
+                (e == POSSIBLE ? assets::textures::stage::evaluation::possible : assets::textures::stage::evaluation::impossible).apply(sprite);
+                sprite.setPosition(_win.x/50, _win.y/50);
+                target_.draw(sprite);
+            }
+        }
+        /**
+         * \return Pixels per sample of the preview shown, `1` once it is
+         * exact, `0` before the first `update()`
+        */
+        unsigned int scale() const {return _shown_scale;}
+        /**
+         * \return Whether the stage being previewed is possible, see `Stage::possible()`
+        */
+        Evaluation evaluation() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _evaluation;
+        }
+    };
 }
 
 namespace bot {
@@ -367,55 +1825,80 @@ namespace bot {
         private:
         rs::Position& _parent_pos;
         stage::Stage& _stage;
+        const stage::SonarTable* _table = nullptr;
+        double _beam_width = 0.0; // Full width of the beam in radians, `0` for a ray
 
         const double _rots = pi/2; // Sonar rotation speed in rad/s
         const unsigned int _cast_count = 18;
-        const double _cast_resolution = 1.0;
+        double _cast_resolution = 1.0;
+        unsigned int _cast_stride = 1;
         const double _fov = pi;
         const double _max_dist = 100.0;
         
         unsigned int _step = 0;
         bool _bounce = false;
 
-        unsigned int data_index = 0;
+        std::vector<DataPoint> _data; // Latest reading at each step of the cycle, ordered by angle
+        rs::Vectors2<double> _directions; // Cosine and sine of each step's rotation relative to the parent
 
-        std::vector<DataPoint> _data;
+        mutable double _heading_rot = 0.0; // Parent rotation that `_heading` was solved for
+        mutable rs::Vector2<double> _heading = rs::Vector2<double>(1.0, 0.0);
 
         void manage_bounce() {
             if (_step == 0) {_bounce = false;}
             else if (_step == _cast_count) {_bounce = true;}
         }
-        double rotation() const {
-            double rot = (_step*_fov)/(_cast_count);
+        double rotation(unsigned int step_) const {
+            double rot = (step_*_fov)/(_cast_count);
             double offset = -(_fov/2.0);
             return rot + offset;
         }
+        double rotation() const {return rotation(_step);}
         
         public:
         Sonar(rs::Position& parent_pos_, stage::Stage& stage_) :
         _parent_pos(parent_pos_),
         _stage(stage_),
-        _data(_cast_count) {
-            _data.resize(_cast_count);
-            _data.shrink_to_fit();
+        _data(_cast_count + 1) {
+            std::vector<double> rotations(_cast_count + 1);
+            for (unsigned int i = 0; i <= _cast_count; i++) {
+                rotations[i] = rotation(i);
+                _data[i] = DataPoint(rotations[i], 0.0);
+            }
+            _directions.from_bearings(1.0, rs::Span<const double>(rotations.data(), rotations.size()));
         }
         /**
          * \return The distance reading of the sonar
         */
         double distance() const {
-            rs::Vector2<double> cast;
             auto current = position();
-
-            for (double probe_dist = 0.0 ;; probe_dist+=_cast_resolution) {
-
-                cast.from_bearing(probe_dist, current.rotation);
-
-                rs::Vector2<double> probe_point = current.position;
-                probe_point.x += cast.x;
-                probe_point.y += cast.y;
-
-                if (_stage.collision(probe_point) or probe_dist == _max_dist) {return probe_dist;}
+            if (_table != nullptr) {return _table->distance(current);}
+            if (_beam_width > 0.0) {return _stage.cone_distance(current.position, current.rotation, _beam_width/2, _max_dist);}
+            return _stage.sonar_distance(current.position, direction(), _cast_resolution, _max_dist, _cast_stride);
+        }
+        /**
+         * \brief The reading the sonar would take from any position, with
+         * the same table, beam and probing settings. Safe to call from
+         * several threads at once
+         * \param pos_ Position and heading of the sonar
+         * \return The distance reading
+        */
+        double distance(rs::Position pos_) const {
+            if (_table != nullptr) {return _table->distance(pos_);}
+            if (_beam_width > 0.0) {return _stage.cone_distance(pos_.position, pos_.rotation, _beam_width/2, _max_dist);}
+            return _stage.sonar_distance(pos_.position, pos_.rotation, _cast_resolution, _max_dist, _cast_stride);
+        }
+        /**
+         * \brief The parent's heading is only solved again when it turns,
+         * the sonar's own rotation at each step is precomputed
+         * \return Unit vector in the direction the sonar is facing
+        */
+        rs::Vector2<double> direction() const {
+            if (_parent_pos.rotation != _heading_rot) {
+                _heading_rot = _parent_pos.rotation;
+                _heading.from_bearing(1.0, _heading_rot);
             }
+            return _directions[_step].rotated(_heading);
         }
         /**
          * \return `true` if the sonar is at it's last step in the cycle
@@ -425,12 +1908,44 @@ namespace bot {
         }
         /**
          * \brief Can only be called during the last step of the cycle
-         * \return A vector of the data collected during the cycle
+         * \return A vector of the data collected during the cycle, ordered by angle
         */
         std::vector<DataPoint> data() const {
+            auto r = readings();
+            return std::vector<DataPoint>(r.begin(), r.end());
+        }
+        /**
+         * \brief Can only be called during the last step of the cycle.
+         * Does not copy the data
+         * \return The data collected during the cycle, ordered by angle
+        */
+        rs::Span<const DataPoint> readings() const {
             if (!at_end()) {throw std::runtime_error("Data not available");}
-            return _data;
+            return rs::Span<const DataPoint>(&_data[first_slot()], _cast_count);
         }
+        /**
+         * \brief The readings of a cycle fill `cast_count()` of the
+         * `cast_count() + 1` slots, depending on the sweep direction
+         * \return The slot of the first (lowest angle) reading of the cycle
+        */
+        unsigned int first_slot() const {return _step == _cast_count ? 1 : 0;}
+        /**
+         * \return The slot the latest reading was stored in
+        */
+        unsigned int slot() const {return _step;}
+        /**
+         * \param slot_ A slot of the cycle
+         * \return The sonar's rotation relative to its parent at that slot
+        */
+        double angle(unsigned int slot_) const {return rotation(slot_);}
+        /**
+         * \return The latest reading
+        */
+        const DataPoint& latest() const {return _data[_step];}
+        /**
+         * \return The number of readings in each cycle
+        */
+        unsigned int cast_count() const {return _cast_count;}
         /**
          * \brief Moves the sonar into the next step of its cycle
         */
@@ -438,10 +1953,7 @@ namespace bot {
             if (_bounce) {_step--;}
             else {_step++;}
             manage_bounce();
-            DataPoint data_point(rotation(), distance());
-            _data[data_index] = data_point;
-            data_index++;
-            if (data_index == _cast_count) {data_index = 0;}
+            _data[_step] = DataPoint(rotation(), distance());
         }
         /**
          * \return The sonar's position
@@ -469,6 +1981,46 @@ namespace bot {
         double range() const {
             return _max_dist;    
         }
+        /**
+         * \return The distance between probes along each reading
+        */
+        double resolution() const {
+            return _cast_resolution;
+        }
+        /**
+         * \return The number of probes skipped by the coarse pass of each reading
+        */
+        unsigned int stride() const {
+            return _cast_stride;
+        }
+        /**
+         * \brief Set how finely each reading is probed.
+         * See `stage::Stage::sonar_distance()` for what the stride can miss
+         * \param resolution_ Distance between probes
+         * \param stride_ Probes skipped by the coarse pass, `1` to test every probe
+        */
+        void set_probing(double resolution_, unsigned int stride_) {
+            if (resolution_ <= 0.0) {throw std::runtime_error("Sonar resolution must be positive");}
+            _cast_resolution = resolution_;
+            _cast_stride = std::max(stride_, 1u);
+        }
+        /**
+         * \brief Take readings from a precomputed table rather than casting
+         * rays. The table must outlive the sonar
+         * \param table_ The table to use, or `nullptr` to cast rays
+        */
+        void use_table(const stage::SonarTable* table_) {_table = table_;}
+        /**
+         * \brief Model the sonar as a cone rather than a ray, returning the
+         * nearest obstacle anywhere in the beam. Most accurate (and fastest)
+         * once the stage has been baked, see `stage::Stage::bake()`
+         * \param width_ Full width of the beam in radians, `0` for a ray
+        */
+        void set_beam_width(double width_) {_beam_width = std::max(width_, 0.0);}
+        /**
+         * \return The full width of the beam in radians
+        */
+        double beam_width() const {return _beam_width;}
     };
     /**
      * \brief A bot.
@@ -480,16 +2032,37 @@ namespace bot {
         const double _pxs = 5.0; // Movement speed in pixels/s
         const double _turn_r = 15;
 
+        const double _m_fw = 1.0; // Speed multipliers for each move type
+        const double _m_bw = -0.6;
+        const double _m_turn = 0.4;
+
         rs::Position _pos;
         stage::Stage& _stage;
 
-        rs::Vector2<double> helix(double angle_, double r_) const {
-            // https://en.wikipedia.org/wiki/Helix
-            // adapted from (cos(t), sin(t))
-            rs::Vector2<double> pos;
-            pos.x = r_*sin(angle_);
-            pos.y = r_*(cos(angle_));
-            return pos;
+        bool _swept = false;
+        double _impact = -1.0;
+
+        mutable double _heading_rot = 0.0; // Rotation that `_heading` was solved for
+        mutable rs::Vector2<double> _heading = rs::Vector2<double>(1.0, 0.0);
+
+        /**
+         * \brief Only solved again when the bot has turned
+         * \return The cosine and sine of the bot's rotation
+        */
+        rs::Vector2<double> heading() const {
+            if (_pos.rotation != _heading_rot) {
+                _heading_rot = _pos.rotation;
+                _heading.from_bearing(1.0, _heading_rot);
+            }
+            return _heading;
+        }
+        void turn_to(double angle_) {
+            // The new heading is needed to move, so is kept for the next step
+            rs::Vector2<double> dir;
+            dir.from_bearing(1.0, angle_);
+            _pos.rotation = radians::wrap(angle_);
+            _heading_rot = _pos.rotation;
+            _heading = dir;
         }
         
         protected:
@@ -497,34 +2070,82 @@ namespace bot {
         MoveType _current_move = FORWARD;
 
         void fw(double s_) {
-            double const m = 1;
-            _pos.position.x += m*s_*cos(_pos.rotation);
-            _pos.position.y += m*s_*sin(_pos.rotation);
+            double const m = _m_fw;
+            const rs::Vector2<double> h = heading();
+            _pos.position.x += m*s_*h.x;
+            _pos.position.y += m*s_*h.y;
         }
         void bw(double s_) {
-            double const m = -0.6;
-            _pos.position.x += m*s_*cos(_pos.rotation);
-            _pos.position.y += m*s_*sin(_pos.rotation);
+            double const m = _m_bw;
+            const rs::Vector2<double> h = heading();
+            _pos.position.x += m*s_*h.x;
+            _pos.position.y += m*s_*h.y;
         }
         void lft(double s_) {
-            double const m = 0.4;
+            // Moves along a circle of radius `_turn_r` to the bot's left
+            double const m = _m_turn;
             double angle_change = (s_*m)/_turn_r;
-            double angle = _pos.rotation - angle_change;
-            auto v1 = helix(-_pos.rotation, _turn_r);
-            auto v2 = helix(-angle, _turn_r);
-            _pos.position.x += v2.x - v1.x;
-            _pos.position.y += v2.y - v1.y;
-            _pos.rotation = radians::wrap(angle);;
+            const rs::Vector2<double> from = heading();
+            turn_to(_pos.rotation - angle_change);
+            _pos.position.x += _turn_r*(from.y - _heading.y);
+            _pos.position.y += _turn_r*(_heading.x - from.x);
         }
         void rgt(double s_) {
-            double const m = 0.4;
+            // Moves along a circle of radius `_turn_r` to the bot's right
+            double const m = _m_turn;
             double angle_change = (s_*m)/_turn_r;
-            double angle = _pos.rotation + angle_change;
-            auto v1 = helix(_pos.rotation, _turn_r);
-            auto v2 = helix(angle, _turn_r);
-            _pos.position.x += v2.x - v1.x;
-            _pos.position.y -= v2.y - v1.y;
-            _pos.rotation = radians::wrap(angle);
+            const rs::Vector2<double> from = heading();
+            turn_to(_pos.rotation + angle_change);
+            _pos.position.x += _turn_r*(_heading.y - from.y);
+            _pos.position.y -= _turn_r*(_heading.x - from.x);
+        }
+        /**
+         * \brief Steps the sonar. Overwritten to act on each new reading
+        */
+        virtual void scan() {_sonar.step();}
+
+        void displace(double s_) {
+            switch (_current_move)
+            {
+            case FORWARD: fw(s_); break;
+            case BACKWARD: bw(s_); break;
+            case LEFT: lft(s_); break;
+            case RIGHT: rgt(s_); break;
+            default:
+                throw std::runtime_error("Invalid move type");
+                break;
+            }
+        }
+        void sweep(rs::Position start_, double s_) {
+            // Re-traces the move from `start_` to the current position and
+            // stops the bot where it first collides
+            _impact = -1.0;
+            rs::Position end = _pos;
+            unsigned int chords = 1;
+            if (_current_move == LEFT or _current_move == RIGHT) {
+                // Split arcs so no chord strays more than half a pixel from the arc
+                const double max_angle = 2*acos(1 - 0.5/_turn_r);
+                chords = std::max(1u, static_cast<unsigned int>(ceil(((s_*_m_turn)/_turn_r)/max_angle)));
+            }
+            rs::Vector2<double> from = start_.position;
+            for (unsigned int i = 1; i <= chords; i++) {
+                rs::Vector2<double> to = end.position;
+                if (i < chords) {
+                    _pos = start_;
+                    displace((s_*i)/chords);
+                    to = _pos.position;
+                }
+                double toi;
+                if (_stage.sweep(from, to, toi)) {
+                    _impact = (s_*(i - 1 + toi))/chords;
+                    _pos = start_;
+                    displace(_impact);
+                    _pos.position = rs::Vector2<double>(from.x + (to.x - from.x)*toi, from.y + (to.y - from.y)*toi);
+                    return;
+                }
+                from = to;
+            }
+            _pos = end;
         }
 
         public:
@@ -543,24 +2164,57 @@ namespace bot {
          * \param s_ Time passed in seconds
         */
         void move(double s_) {
-            rs::Position move;
-            switch (_current_move)
-            {
-            case FORWARD: fw(s_); break;
-            case BACKWARD: bw(s_); break;
-            case LEFT: lft(s_); break;
-            case RIGHT: rgt(s_); break;
-            default:
-                throw std::runtime_error("Invalid move type");
-                break;
-            }
+            rs::Position start = _pos;
+            displace(s_);
+            if (_swept) {sweep(start, s_);}
         }
+        /**
+         * \brief If `true`, the whole path of each move is checked for
+         * collisions rather than just where it ends. The bot stops at the
+         * first point of contact, so large time steps cannot skip walls.
+         * `stage::Stage::bake()` makes this much faster
+         * \param enable_
+        */
+        void swept_collision(bool enable_) {_swept = enable_;}
+        /**
+         * \brief Take sonar readings from a precomputed table.
+         * See `bot::Sonar::use_table()`
+         * \param table_ The table to use, or `nullptr` to cast rays
+        */
+        void sonar_table(const stage::SonarTable* table_) {_sonar.use_table(table_);}
+        /**
+         * \brief Set the width of the sonar's beam.
+         * See `bot::Sonar::set_beam_width()`
+         * \param width_ Full width of the beam in radians, `0` for a ray
+        */
+        void sonar_beam(double width_) {_sonar.set_beam_width(width_);}
+        /**
+         * \brief Set how finely the sonar probes each reading.
+         * See `bot::Sonar::set_probing()`
+         * \param resolution_ Distance between probes
+         * \param stride_ Probes skipped by the coarse pass, `1` to test every probe
+        */
+        void sonar_probing(double resolution_, unsigned int stride_) {_sonar.set_probing(resolution_, stride_);}
+        /**
+         * \brief Only set when swept collisions are enabled
+         * \return The time in seconds into the last move at which the bot
+         * collided, or a negative value if it did not
+        */
+        double impact_time() const {return _impact;}
         /**
          * \return The bot's position and rotation
         */
         rs::Position get_position() const {
             return _pos;
         }
+        /**
+         * \return The bot's sonar
+        */
+        const Sonar& get_sonar() const {return _sonar;}
+        /**
+         * \return The move the bot is currently making
+        */
+        MoveType get_move() const {return _current_move;}
         /**
          * \brief Sets the bots position and rotation
          * \param pos_ The new position and rotation
@@ -582,10 +2236,71 @@ namespace bot {
         virtual void step() { // Overwritten by Bot_wBrain
             double time_elapsed = _sonar.gap();
             move(time_elapsed);
-            _sonar.step();
+            scan();
 
             // Nothing more is done as this bot has no "brain"
         }
+        /**
+         * \brief Moves the bot and steps the sonar until the sonar reaches
+         * the end of its cycle (the next point a move can be decided).
+         * Gives the same path as repeated calls to `Bot::step()` up to
+         * rounding, as the trigonometry is solved once per call rather than
+         * once per step.
+         * Stops early if the bot collides or leaves the stage, or once
+         * `max_steps_` steps have been taken (the cycle then carries on
+         * in the next call)
+         * \param max_steps_ Most steps to take
+         * \return The number of steps taken
+        */
+        virtual unsigned int advance(unsigned int max_steps_ = std::numeric_limits<unsigned int>::max()) { // Overwritten by Bot_wBrain
+            const double s = _sonar.gap();
+            unsigned int steps = 0;
+            if (max_steps_ == 0) {return 0;}
+            switch (_current_move)
+            {
+            case FORWARD:
+            case BACKWARD: {
+                // Straight line, the same displacement every step
+                rs::Vector2<double> delta;
+                delta.from_bearing((_current_move == FORWARD ? _m_fw : _m_bw)*s, _pos.rotation);
+                do {
+                    rs::Position start = _pos;
+                    _pos.position.x += delta.x;
+                    _pos.position.y += delta.y;
+                    if (_swept) {sweep(start, s);}
+                    scan();
+                    steps++;
+                } while (!_sonar.at_end() and !collided() and in_bounds() and steps < max_steps_);
+                break;
+            }
+            case LEFT:
+            case RIGHT: {
+                // Arc around a fixed centre. The offset from the centre is
+                // rotated by the same angle every step
+                const double angle_change = (_current_move == LEFT ? -1.0 : 1.0)*(s*_m_turn)/_turn_r;
+                const double c = cos(angle_change);
+                const double sn = sin(angle_change);
+                rs::Vector2<double> offset;
+                offset.from_bearing(_turn_r, _pos.rotation + (_current_move == LEFT ? pi/2 : -pi/2));
+                do {
+                    rs::Position start = _pos;
+                    rs::Vector2<double> next(offset.x*c - offset.y*sn, offset.x*sn + offset.y*c);
+                    _pos.position.x += next.x - offset.x;
+                    _pos.position.y += next.y - offset.y;
+                    _pos.rotation = radians::wrap(_pos.rotation + angle_change);
+                    offset = next;
+                    if (_swept) {sweep(start, s);}
+                    scan();
+                    steps++;
+                } while (!_sonar.at_end() and !collided() and in_bounds() and steps < max_steps_);
+                break;
+            }
+            default:
+                throw std::runtime_error("Invalid move type");
+                break;
+            }
+            return steps;
+        }
         /**
          * \return `true` if the bot is in-bounds
         */
@@ -599,14 +2314,30 @@ namespace bot {
             return _stage.collision(_pos.position);
         }
         stage::Stage& stage() {return _stage;}
+        const stage::Stage& stage() const {return _stage;}
     };
+    /**
+     * \param outputs_ Values of a network's output layer, at least one per move type
+     * \return The move type with the highest output, the first on a tie
+    */
+    MoveType best_move(const double* outputs_) {
+        MoveType best = FORWARD;
+        for (unsigned int i = 1; i < 4; i++) {
+            if (outputs_[i] > outputs_[best]) {best = static_cast<MoveType>(i);}
+        }
+        return best;
+    }
     /**
      * \brief Inherits `bot::Bot`.
      * Move type is based on the output of a `nn::Network`
     */
     class Bot_wBrain : public Bot {
-        private:
-        double data_func(double x_) const {
+        public:
+        /**
+         * \param x_ A sonar distance
+         * \return The network input for that distance
+        */
+        static double data_func(double x_) {
             const double e = 2.71828;
             const double i = 20.0; // X-axis intercept
             const double s = 15; // Scale
@@ -614,51 +2345,386 @@ namespace bot {
             return y;
         }
 
+        private:
         nn::Network _brain;
-        bot::MoveType calc_move(std::vector<DataPoint> data_) const {
-            std::sort(
-                data_.begin(), data_.end(),
-                [] (const DataPoint &a, const DataPoint &b)
-                {
-                    return a.angle < b.angle;
-                }
-            );
-            std::vector<double> nn_input;
-            for (auto dp : data_) {
-                nn_input.push_back(data_func(dp.distance));
+        std::vector<double> _inputs; // Network input for each sonar slot, updated as readings arrive
+
+        bool _incremental = false;
+        const unsigned int _refresh_interval = 1000; // Decisions between exact recalculations of `_sums`
+        unsigned int _decisions = 0;
+        // First layer weighted sums for each possible first slot
+        // (the sweep direction decides which slots make up the input)
+        std::vector<double> _sums[2];
+
+        std::vector<double> _outputs; // Network output from the latest decision
+        unsigned long long _decided = 0; // Decisions made so far
+
+        void refresh_sums() {
+            _sums[0] = _brain.weighted_sums(&_inputs[0]);
+            _sums[1] = _brain.weighted_sums(&_inputs[1]);
+        }
+
+        bot::MoveType calc_move() {
+            std::vector<double> nn_output;
+            if (_incremental) {
+                // Clears accumulated rounding error
+                if (++_decisions >= _refresh_interval) {refresh_sums(); _decisions = 0;}
+                nn_output = _brain.calculate_from_sums(_sums[_sonar.first_slot()]);
             }
-            nn_input.shrink_to_fit();
-            auto nn_output = _brain.calculate(nn_input);
-            bot::MoveType best_move = FORWARD;
-            for (unsigned int i = 1; i < 4; i++) {
-                if (nn_output[i] > nn_output[best_move]) {
-                    best_move = static_cast<bot::MoveType>(i);
+            else {nn_output = _brain.calculate(&_inputs[_sonar.first_slot()]);}
+            _outputs = std::move(nn_output);
+            _decided++;
+            return best_move(_outputs.data());
+        }
+
+        protected:
+        void scan() override {
+            Bot::scan();
+            const unsigned int slot = _sonar.slot();
+            const double input = data_func(_sonar.latest().distance);
+            if (_incremental) {
+                const double delta = input - _inputs[slot];
+                for (unsigned int first = 0; first < 2; first++) {
+                    // Slot is input node `slot - first` when the cycle starts at `first`
+                    if (slot >= first and slot - first < _sonar.cast_count()) {
+                        _brain.accumulate(_sums[first], slot - first, delta);
+                    }
                 }
             }
-            return best_move;
+            _inputs[slot] = input;
         }
 
         public:
         Bot_wBrain(stage::Stage& stage_, nn::Network nn_) :
             Bot(stage_),
-            _brain(nn_)
+            _brain(nn_),
+            _inputs(_sonar.cast_count() + 1, data_func(0.0))
         {}
         /**
          * \brief Calculates a move. Moves the bot and steps the sonar
         */
         void step() override {
             if (_sonar.at_end()) {
-                auto data = _sonar.data();
-                _current_move = calc_move(data);
+                _current_move = calc_move();
             }
             Bot::step(); // Moves the bot to it's next pos, step the sonar
         }
+        /**
+         * \brief Calculates a move, then moves the bot until the next move
+         * is due. See `Bot::advance()`
+         * \param max_steps_ Most steps to take
+         * \return The number of steps taken
+        */
+        unsigned int advance(unsigned int max_steps_ = std::numeric_limits<unsigned int>::max()) override {
+            if (max_steps_ == 0) {return 0;}
+            if (_sonar.at_end()) {
+                _current_move = calc_move();
+            }
+            return Bot::advance(max_steps_);
+        }
+        /**
+         * \brief If `true`, the first layer of the network is updated as
+         * each sonar reading arrives, so a move only needs the remaining
+         * layers calculating. Results match to within rounding error
+         * \param enable_
+        */
+        void incremental_inference(bool enable_) {
+            _incremental = enable_;
+            _decisions = 0;
+            if (_incremental) {refresh_sums();}
+        }
         /**
          * \return The `nn::Network` object used for calculating moves
         */
         nn::Network brain() const {
             return _brain;
         }
+        /**
+         * \return The network's output from the latest decision, empty
+         * until the first move has been calculated
+        */
+        const std::vector<double>& outputs() const {return _outputs;}
+        /**
+         * \return The number of moves calculated so far
+        */
+        unsigned long long decisions() const {return _decided;}
+    };
+    /**
+     * \brief Conditions that end an episode early
+    */
+    struct Termination {
+        bool on_collision = true; // End when the bot hits a collision area
+        bool on_exit = true; // End (successfully) when the bot leaves the stage
+        bool on_stagnation = true; // End when the bot stops making progress
+        unsigned int cell_size = 32; // Size in pixels of each visited-cell
+        unsigned int window = 150; // Number of decisions to look back over
+        unsigned int min_cells = 5; // Fewer distinct cells than this in the window counts as no progress
+    };
+    /**
+     * \brief Runs a `bot::Bot` until a `bot::Termination` condition is met
+     * or a step limit is reached.
+     * Steps the bot one decision at a time with `Bot::advance()`
+    */
+    class Episode {
+        public:
+        enum Outcome {
+            RUNNING,
+            COLLIDED,
+            ESCAPED,
+            STAGNATED,
+            TIMED_OUT
+        };
+
+        private:
+        Bot& _bot;
+        Termination _policy;
+
+        unsigned int _steps = 0;
+        Outcome _outcome = RUNNING;
+
+        std::deque<std::uint64_t> _recent; // Cell visited at each decision in the window
+        std::unordered_map<std::uint64_t, unsigned int> _visits; // Number of times each cell appears in the window
+
+        std::uint64_t cell() const {
+            auto pos = _bot.get_position().position;
+            long long x = static_cast<long long>(floor(pos.x / _policy.cell_size));
+            long long y = static_cast<long long>(floor(pos.y / _policy.cell_size));
+            // Packed unsigned, as shifting a negative value is undefined
+            return static_cast<std::uint64_t>(y) << 32 | static_cast<std::uint32_t>(x);
+        }
+        bool stagnated() {
+            std::uint64_t c = cell();
+            _recent.push_back(c);
+            _visits[c]++;
+            if (_recent.size() > _policy.window) {
+                auto it = _visits.find(_recent.front());
+                if (--(it->second) == 0) {_visits.erase(it);}
+                _recent.pop_front();
+            }
+            return _recent.size() >= _policy.window and _visits.size() < _policy.min_cells;
+        }
+
+        public:
+        Episode(Bot& bot_, Termination policy_) : _bot(bot_), _policy(policy_) {}
+        Episode(Bot& bot_) : Episode(bot_, Termination()) {}
+        /**
+         * \brief Steps the bot until the episode ends
+         * \param max_steps_ Number of steps before the episode times out
+         * \return How the episode ended
+        */
+        Outcome run(unsigned int max_steps_) {
+            while (_outcome == RUNNING) {
+                if (_steps >= max_steps_) {_outcome = TIMED_OUT; break;}
+                // The last decision is cut short so the budget is never exceeded
+                _steps += _bot.advance(max_steps_ - _steps);
+
+                if (_policy.on_exit and !_bot.in_bounds()) {_outcome = ESCAPED;}
+                else if (_policy.on_collision and _bot.collided()) {_outcome = COLLIDED;}
+                else if (_policy.on_stagnation and stagnated()) {_outcome = STAGNATED;}
+            }
+            return _outcome;
+        }
+        /**
+         * \return How the episode ended, or `RUNNING` if it has not
+        */
+        Outcome outcome() const {return _outcome;}
+        /**
+         * \return The number of steps taken so far
+        */
+        unsigned int steps() const {return _steps;}
+    };
+    /**
+     * \brief The move a bot's network prefers at every pose on a grid of
+     * positions and headings, to show what the network has learned.
+     * At each pose the bot is taken to have scanned a whole cycle without
+     * moving. Headings are spaced by whole sonar steps, so each reading
+     * is shared by every heading that uses it
+    */
+    class PolicyMap {
+        private:
+        static constexpr char magic[8] = {'P','C','M','P','P','O','L','Y'};
+        static const std::uint32_t version = 1;
+
+        unsigned int _cell = 0;
+        unsigned int _headings = 0;
+        unsigned int _output_count = 0;
+        rs::Vector2<unsigned int> _cells;
+        rs::Vector2<unsigned int> _win;
+        unsigned int _seed = 0;
+        double _build_seconds = 0.0;
+
+        std::vector<std::uint8_t> _moves; // Preferred move of each pose, or `blocked`
+        std::vector<float> _outputs; // Network outputs of each pose
+
+        std::size_t index(unsigned int cx_, unsigned int cy_, unsigned int h_) const {
+            return (std::size_t(cy_)*_cells.x + cx_)*_headings + h_;
+        }
+
+        public:
+        static constexpr std::uint8_t blocked = 255; // Poses inside a collision area
+
+        /**
+         * \brief Evaluate the bot's network at every pose, using every
+         * available thread. Each row of cells is evaluated as one batch
+         * \param bot_ The bot whose network, sonar settings and stage are used
+         * \param cell_ Size of each grid cell in pixels
+         * \param heading_steps_ Sonar steps between headings, `1` for the most headings
+         * \param first_slot_ Which sonar slots the network reads, see `bot::Sonar::first_slot()`
+        */
+        void build(const Bot_wBrain& bot_, unsigned int cell_, unsigned int heading_steps_ = 1, unsigned int first_slot_ = 0) {
+            auto start = std::chrono::steady_clock::now();
+            const stage::Stage& stage = bot_.stage();
+            const Sonar& sonar = bot_.get_sonar();
+            const nn::Network brain = bot_.brain();
+            const std::vector<unsigned int> shape = brain.shape();
+            const unsigned int input_count = sonar.cast_count();
+            if (shape.front() != input_count or shape.back() < 4) {
+                throw std::runtime_error("Network does not match the sonar");
+            }
+            if (first_slot_ > 1) {throw std::runtime_error("Invalid first slot");}
+
+            // Readings are taken at every sonar step around a full turn
+            const double step = sonar.fov()/input_count;
+            const unsigned int turn = static_cast<unsigned int>(lround((2*pi)/step));
+            heading_steps_ = std::max(heading_steps_, 1u);
+            if (std::abs(turn*step - 2*pi) > 1e-9 or turn % heading_steps_ != 0) {
+                throw std::runtime_error("Headings must divide a full turn into whole sonar steps");
+            }
+            std::vector<unsigned int> offsets(input_count); // Steps from the heading to each input's reading
+            for (unsigned int i = 0; i < input_count; i++) {
+                const long o = lround(sonar.angle(first_slot_ + i)/step);
+                offsets[i] = static_cast<unsigned int>(((o % long(turn)) + turn) % turn);
+            }
+
+            _cell = std::max(1u, cell_);
+            _headings = turn/heading_steps_;
+            _output_count = shape.back();
+            _win = stage.window_size();
+            _cells = rs::Vector2<unsigned int>((_win.x + _cell - 1)/_cell, (_win.y + _cell - 1)/_cell);
+            _seed = stage.seed;
+            _moves.assign(std::size_t(_cells.x)*_cells.y*_headings, blocked);
+            _outputs.assign(_moves.size()*_output_count, 0.0f);
+
+            // Rows are shared out between threads
+            auto fill_rows = [&] (unsigned int first_, unsigned int step_) {
+                const std::size_t batch = std::size_t(_cells.x)*_headings;
+                std::vector<double> readings(turn);
+                std::vector<double> inputs(batch*input_count);
+                std::vector<double> outputs(batch*_output_count);
+                for (unsigned int cy = first_; cy < _cells.y; cy += step_) {
+                    for (unsigned int cx = 0; cx < _cells.x; cx++) {
+                        rs::Vector2<double> centre((cx + 0.5)*_cell, (cy + 0.5)*_cell);
+                        for (unsigned int k = 0; k < turn; k++) {
+                            readings[k] = Bot_wBrain::data_func(sonar.distance(rs::Position(centre, k*step)));
+                        }
+                        for (unsigned int h = 0; h < _headings; h++) {
+                            double* in = &inputs[(std::size_t(cx)*_headings + h)*input_count];
+                            for (unsigned int i = 0; i < input_count; i++) {
+                                in[i] = readings[(h*heading_steps_ + offsets[i]) % turn];
+                            }
+                        }
+                    }
+                    brain.calculate_batch(inputs.data(), batch, outputs.data());
+                    for (unsigned int cx = 0; cx < _cells.x; cx++) {
+                        if (stage.collision(rs::Vector2<double>((cx + 0.5)*_cell, (cy + 0.5)*_cell))) {continue;}
+                        for (unsigned int h = 0; h < _headings; h++) {
+                            const double* out = &outputs[(std::size_t(cx)*_headings + h)*_output_count];
+                            const std::size_t i = index(cx, cy, h);
+                            _moves[i] = static_cast<std::uint8_t>(best_move(out));
+                            std::copy(out, out + _output_count, &_outputs[i*_output_count]);
+                        }
+                    }
+                }
+            };
+            unsigned int thread_count = std::max(1u, std::thread::hardware_concurrency());
+            std::vector<std::thread> threads;
+            for (unsigned int t = 0; t < thread_count; t++) {threads.emplace_back(fill_rows, t, thread_count);}
+            for (auto& t : threads) {t.join();}
+
+            _build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        /**
+         * \param cx_ Column of cells
+         * \param cy_ Row of cells
+         * \param h_ Heading, `h_*2*pi/headings()` radians
+         * \return The preferred move type, or `blocked`
+        */
+        std::uint8_t move(unsigned int cx_, unsigned int cy_, unsigned int h_) const {return _moves[index(cx_, cy_, h_)];}
+        /**
+         * \param cx_ Column of cells
+         * \param cy_ Row of cells
+         * \param h_ Heading, `h_*2*pi/headings()` radians
+         * \param output_ Output node
+         * \return The network's output, `0` if the pose is blocked
+        */
+        float output(unsigned int cx_, unsigned int cy_, unsigned int h_, unsigned int output_) const {
+            return _outputs[index(cx_, cy_, h_)*_output_count + output_];
+        }
+        /**
+         * \brief Draw one heading of the map, one pixel per cell.
+         * Forward is green, backward red, left blue and right yellow. The
+         * brighter the colour, the further the preferred output is ahead
+         * of the next best
+         * \param h_ Heading to draw
+         * \return The image
+        */
+        sf::Image image(unsigned int h_) const {
+            sf::Image img;
+            img.create(std::max(_cells.x, 1u), std::max(_cells.y, 1u), sf::Color::Black);
+            for (unsigned int cy = 0; cy < _cells.y; cy++) {
+                for (unsigned int cx = 0; cx < _cells.x; cx++) {
+                    const std::size_t i = index(cx, cy, h_);
+                    if (_moves[i] == blocked) {continue;}
+                    const float* out = &_outputs[i*_output_count];
+                    float second = -1e30f;
+                    for (unsigned int o = 0; o < 4; o++) {
+                        if (o != _moves[i]) {second = std::max(second, out[o]);}
+                    }
+                    const float shade = 0.25f + 0.75f*std::clamp(out[_moves[i]] - second, 0.0f, 1.0f);
+                    sf::Color c;
+                    switch (_moves[i])
+                    {
+                    case FORWARD: c = sf::Color(0, 255, 0); break;
+                    case BACKWARD: c = sf::Color(255, 0, 0); break;
+                    case LEFT: c = sf::Color(0, 96, 255); break;
+                    case RIGHT: c = sf::Color(255, 255, 0); break;
+                    default: break;
+                    }
+                    img.setPixel(cx, cy, sf::Color(c.r*shade, c.g*shade, c.b*shade));
+                }
+            }
+            return img;
+        }
+        /**
+         * \brief Write the map to a binary file. The layout is the magic,
+         * then version, window width and height, cell size, headings, outputs
+         * per pose and stage seed as 32 bit values, then the moves row by row
+         * with every heading of a cell together, then the outputs as floats
+         * in the same order
+         * \param path_ File to write
+        */
+        void save(const std::string& path_) const {
+            if (_moves.empty()) {throw std::runtime_error("Policy map has not been built");}
+            std::ofstream file(path_, std::ofstream::binary);
+            if (!file.good()) {throw std::runtime_error("Unable to write policy map");}
+            std::uint32_t fields[7] = {version, _win.x, _win.y, _cell, _headings, _output_count, _seed};
+            file.write(magic, sizeof(magic));
+            file.write(reinterpret_cast<const char*>(fields), sizeof(fields));
+            file.write(reinterpret_cast<const char*>(_moves.data()), _moves.size());
+            file.write(reinterpret_cast<const char*>(_outputs.data()), _outputs.size()*sizeof(float));
+        }
+        /**
+         * \return Number of cells across and down
+        */
+        rs::Vector2<unsigned int> cells() const {return _cells;}
+        /**
+         * \return Number of headings evaluated in each cell
+        */
+        unsigned int headings() const {return _headings;}
+        /**
+         * \return Time in seconds the last `build()` took
+        */
+        double build_seconds() const {return _build_seconds;}
     };
     class DisplayedBot : public Bot_wBrain {
         private:
@@ -666,15 +2732,19 @@ namespace bot {
         sf::Sprite _s_sonar;
         sf::RenderWindow& _window;
         sf::Image _path;
+        mutable sf::Texture _path_texture; // GPU copy of `_path`
+        mutable bool _path_stale = true; // The whole of `_path_texture` must be uploaded
+        mutable unsigned int _dirty_top = 0; // Rows [_dirty_top, _dirty_bottom) of `_path` are newer than the texture
+        mutable unsigned int _dirty_bottom = 0;
 
         bool _trace_path = false;
 
         public:
         DisplayedBot(stage::Stage& stage_, nn::Network n_, sf::RenderWindow& window_) : Bot_wBrain(stage_, n_), _window(window_) {
-            auto bts = sonar.getSize();
-            auto sts = body.getSize();
-            _s_bot.setTexture(body);
-            _s_sonar.setTexture(sonar);
+            auto bts = sonar.size();
+            auto sts = body.size();
+            body.apply(_s_bot);
+            sonar.apply(_s_sonar);
             _s_bot.setOrigin(sf::Vector2f((bts.x/2),(bts.y/2)));
             _s_sonar.setOrigin(sf::Vector2f((sts.x/2),(sts.y/2)));
 
@@ -690,6 +2760,10 @@ namespace bot {
                 auto pos = get_position().position;
                 if (in_bounds()) {
                     _path.setPixel(pos.x, pos.y, sf::Color(0,255,255,255));
+                    const unsigned int row = pos.y;
+                    if (_dirty_top == _dirty_bottom) {_dirty_top = row;}
+                    _dirty_top = std::min(_dirty_top, row);
+                    _dirty_bottom = std::max(_dirty_bottom, row + 1);
                 }
             }
         }
@@ -729,15 +2803,27 @@ namespace bot {
         void reset_path() {
             auto win = _window.getSize();
             _path.create(win.x, win.y, sf::Color::Transparent);
+            _path_stale = true;
+            _dirty_top = _dirty_bottom = 0;
         }
         /**
-         * \brief Draws the traced path
+         * \brief Draws the traced path.
+         * Only the rows marked since the last draw are uploaded to the GPU
         */
         void draw_path() const {
             if (not _trace_path) {return;}
-            sf::Texture t;
-            t.loadFromImage(_path);
-            sf::Sprite s(t);
+            if (_path_stale) {
+                _path_texture.loadFromImage(_path);
+                _path_stale = false;
+            }
+            else if (_dirty_top < _dirty_bottom) {
+                // The rows are contiguous in the image, so can be uploaded directly
+                const unsigned int width = _path.getSize().x;
+                const sf::Uint8* rows = _path.getPixelsPtr() + std::size_t(4)*width*_dirty_top;
+                _path_texture.update(rows, width, _dirty_bottom - _dirty_top, 0, _dirty_top);
+            }
+            _dirty_top = _dirty_bottom = 0;
+            sf::Sprite s(_path_texture);
             _window.draw(s);
         }
         void draw_fov() const {
@@ -760,4 +2846,996 @@ namespace bot {
     };
 }
 
+namespace view {
+    /**
+     * \brief Hands the latest value from one thread to another without locks.
+     * The writer fills `write_buffer()` and publishes it, the reader fetches
+     * the most recently published value. Neither ever waits for the other,
+     * and values published faster than the reader fetches them are skipped
+    */
+    template <typename T>
+    class TripleBuffer {
+        private:
+        static const unsigned char fresh = 4; // Set while the middle buffer has not been fetched
+
+        T _buffers[3];
+        std::atomic<unsigned char> _middle{1};
+        unsigned char _write = 0; // Only used by the writer
+        unsigned char _read = 2; // Only used by the reader
+
+        public:
+        /**
+         * \brief Writer only. May hold an old value, which can be updated in place
+         * \return The buffer to fill before `publish()`
+        */
+        T& write_buffer() {return _buffers[_write];}
+        /**
+         * \brief Writer only. Makes the write buffer the latest value
+        */
+        void publish() {
+            _write = _middle.exchange(_write | fresh) & 3;
+        }
+        /**
+         * \brief Reader only. Takes the latest value, if there is a new one
+         * \return `true` if `read_buffer()` has changed
+        */
+        bool fetch() {
+            if (!(_middle.load() & fresh)) {return false;}
+            _read = _middle.exchange(_read) & 3;
+            return true;
+        }
+        /**
+         * \brief Reader only
+         * \return The latest fetched value
+        */
+        const T& read_buffer() const {return _buffers[_read];}
+    };
+    /**
+     * \brief What is needed to draw a bot
+    */
+    struct BotState {
+        rs::Position pose;
+        rs::Position sonar;
+        double reading = 0.0; // Latest sonar distance
+        double fov = 0.0; // Sonar field of view
+        double range = 0.0; // Sonar range
+        bool active = true; // `false` once the bot has collided, left the stage or run out of steps
+        std::vector<rs::Vector2<float>> path;
+    };
+    /**
+     * \brief The simulation at one moment
+    */
+    struct Snapshot {
+        unsigned long long step = 0;
+        double time = 0.0; // Simulated seconds
+        std::vector<BotState> bots;
+    };
+    /**
+     * \brief Runs bots on their own thread, publishing snapshots for a
+     * render thread to draw. Simulation never waits for drawing
+    */
+    class Simulator {
+        private:
+        std::vector<bot::Bot*> _bots;
+        std::vector<std::vector<rs::Vector2<float>>> _paths;
+        std::vector<char> _active;
+        unsigned long long _max_steps;
+        unsigned long long _step = 0;
+        double _time = 0.0;
+
+        TripleBuffer<Snapshot> _snapshots;
+        std::thread _thread;
+        std::atomic<bool> _running{false};
+        std::atomic<double> _fast_forward{1.0};
+        std::atomic<unsigned int> _decimation{1};
+        const float _path_spacing = 1.0f; // Shortest distance between path points
+
+        void record(unsigned int i_) {
+            auto pos = _bots[i_]->get_position().position;
+            auto& path = _paths[i_];
+            if (!path.empty()) {
+                float dx = pos.x - path.back().x;
+                float dy = pos.y - path.back().y;
+                if (dx*dx + dy*dy < _path_spacing*_path_spacing) {return;}
+            }
+            path.push_back(rs::Vector2<float>(pos.x, pos.y));
+        }
+
+        void publish() {
+            Snapshot& snap = _snapshots.write_buffer();
+            snap.step = _step;
+            snap.time = _time;
+            snap.bots.resize(_bots.size());
+            for (unsigned int i = 0; i < _bots.size(); i++) {
+                BotState& state = snap.bots[i];
+                const bot::Sonar& sonar = _bots[i]->get_sonar();
+                state.pose = _bots[i]->get_position();
+                state.sonar = sonar.position();
+                state.reading = sonar.latest().distance;
+                state.fov = sonar.fov();
+                state.range = sonar.range();
+                state.active = _active[i];
+                // The buffer already holds the path up to when it was last
+                // published, so only the newer points are copied
+                auto& path = state.path;
+                if (path.size() > _paths[i].size()) {path.clear();}
+                path.insert(path.end(), _paths[i].begin() + path.size(), _paths[i].end());
+            }
+            _snapshots.publish();
+        }
+
+        void run() {
+            auto start = std::chrono::steady_clock::now();
+            double start_time = _time;
+            double rate = _fast_forward;
+            bool any = true;
+            while (_running and any) {
+                any = false;
+                double gap = 0.0;
+                for (unsigned int i = 0; i < _bots.size(); i++) {
+                    if (!_active[i]) {continue;}
+                    auto& b = *_bots[i];
+                    b.step();
+                    record(i);
+                    gap = std::max(gap, b.get_sonar().gap());
+                    if (b.collided() or !b.in_bounds() or (_max_steps > 0 and _step + 1 >= _max_steps)) {_active[i] = false;}
+                    any = true;
+                }
+                _step++;
+                _time += gap;
+                if (_step % _decimation == 0 or !any) {publish();}
+
+                // Pace the simulation. A fast-forward of 0 runs flat out
+                if (rate != _fast_forward) {
+                    rate = _fast_forward;
+                    start = std::chrono::steady_clock::now();
+                    start_time = _time;
+                }
+                if (rate > 0.0) {
+                    auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>((_time - start_time)/rate));
+                    if (due > std::chrono::steady_clock::now()) {std::this_thread::sleep_until(due);}
+                }
+            }
+            publish();
+            _running = false;
+        }
+
+        public:
+        /**
+         * \param bots_ Bots to run. Must not be used elsewhere until `stop()`
+         * \param max_steps_ Steps each bot may take, `0` for no limit
+        */
+        Simulator(std::vector<bot::Bot*> bots_, unsigned long long max_steps_ = 0) :
+        _bots(bots_),
+        _paths(bots_.size()),
+        _active(bots_.size(), true),
+        _max_steps(max_steps_) {
+            for (unsigned int i = 0; i < _bots.size(); i++) {record(i);}
+            publish();
+        }
+        Simulator(const Simulator&) = delete;
+        Simulator& operator=(const Simulator&) = delete;
+        ~Simulator() {stop();}
+        /**
+         * \brief Start simulating on a new thread
+        */
+        void start() {
+            if (_thread.joinable()) {return;}
+            _running = true;
+            _thread = std::thread(&Simulator::run, this);
+        }
+        /**
+         * \brief Stop simulating and wait for the thread to finish
+        */
+        void stop() {
+            _running = false;
+            if (_thread.joinable()) {_thread.join();}
+        }
+        /**
+         * \return `true` while the simulation thread is running
+        */
+        bool running() const {return _running;}
+        /**
+         * \brief Set how fast simulated time passes. Can be called while running
+         * \param factor_ Simulated seconds per real second, `0` to run as fast as possible
+        */
+        void set_fast_forward(double factor_) {_fast_forward = std::max(factor_, 0.0);}
+        /**
+         * \brief Publish a snapshot only every few steps, so fast runs spend
+         * less time copying. Can be called while running
+         * \param steps_ Steps between snapshots
+        */
+        void set_decimation(unsigned int steps_) {_decimation = std::max(steps_, 1u);}
+        /**
+         * \brief Render thread only. Takes the latest snapshot, if there is a new one
+         * \return `true` if `snapshot()` has changed
+        */
+        bool fetch() {return _snapshots.fetch();}
+        /**
+         * \brief Render thread only
+         * \return The latest fetched snapshot
+        */
+        const Snapshot& snapshot() const {return _snapshots.read_buffer();}
+    };
+    /**
+     * \brief Draw the bots in a snapshot, with their paths
+     * \param snapshot_ What to draw
+     * \param target_ Where to draw it
+    */
+    void draw(const Snapshot& snapshot_, sf::RenderTarget& target_) {
+        sf::Sprite body;
+        sf::Sprite sonar;
+        assets::textures::bot::body.apply(body);
+        assets::textures::bot::sonar.apply(sonar);
+        auto bts = assets::textures::bot::body.size();
+        auto sts = assets::textures::bot::sonar.size();
+        body.setOrigin(sf::Vector2f((bts.x/2),(bts.y/2)));
+        sonar.setOrigin(sf::Vector2f((sts.x/2),(sts.y/2)));
+        for (const BotState& b : snapshot_.bots) {
+            sf::VertexArray path(sf::LineStrip, b.path.size());
+            for (unsigned int i = 0; i < b.path.size(); i++) {
+                path[i] = sf::Vertex(sf::Vector2f(b.path[i].x, b.path[i].y), sf::Color(0,255,255,255));
+            }
+            target_.draw(path);
+        }
+        for (const BotState& b : snapshot_.bots) {
+            body.setPosition(sf::Vector2f(b.pose.position.x, b.pose.position.y));
+            body.setRotation(radians::to_degrees(b.pose.rotation));
+            body.setColor(b.active ? sf::Color::White : sf::Color(255,255,255,120));
+            target_.draw(body);
+            sonar.setPosition(sf::Vector2f(b.sonar.position.x, b.sonar.position.y));
+            sonar.setRotation(radians::to_degrees(b.sonar.rotation));
+            target_.draw(sonar);
+        }
+    }
+    /**
+     * \brief An RGBA image in memory, drawn to in software so no window
+     * or graphics context is needed
+    */
+    struct Frame {
+        unsigned int width = 0;
+        unsigned int height = 0;
+        std::vector<std::uint8_t> pixels; // 4 bytes per pixel, row by row
+
+        Frame() {}
+        Frame(unsigned int width_, unsigned int height_, sf::Color fill_) :
+        width(width_),
+        height(height_),
+        pixels(std::size_t(width_)*height_*4) {
+            for (std::size_t i = 0; i < pixels.size(); i += 4) {
+                pixels[i] = fill_.r;
+                pixels[i+1] = fill_.g;
+                pixels[i+2] = fill_.b;
+                pixels[i+3] = fill_.a;
+            }
+        }
+        /**
+         * \brief Draw a colour over a pixel, mixed by the colour's alpha
+        */
+        void blend(int x_, int y_, sf::Color c_) {
+            if (x_ < 0 or y_ < 0 or x_ >= int(width) or y_ >= int(height)) {return;}
+            std::uint8_t* p = &pixels[(std::size_t(y_)*width + x_)*4];
+            const unsigned int a = c_.a;
+            p[0] = (c_.r*a + p[0]*(255 - a))/255;
+            p[1] = (c_.g*a + p[1]*(255 - a))/255;
+            p[2] = (c_.b*a + p[2]*(255 - a))/255;
+            p[3] = std::max<unsigned int>(p[3], a);
+        }
+        /**
+         * \brief Draw a filled circle
+        */
+        void disc(rs::Vector2<double> centre_, double r_, sf::Color c_) {
+            for (int y = floor(centre_.y - r_); y <= ceil(centre_.y + r_); y++) {
+                for (int x = floor(centre_.x - r_); x <= ceil(centre_.x + r_); x++) {
+                    const double dx = x - centre_.x;
+                    const double dy = y - centre_.y;
+                    if (dx*dx + dy*dy <= r_*r_) {blend(x, y, c_);}
+                }
+            }
+        }
+        /**
+         * \brief Draw a one pixel wide line
+        */
+        void line(rs::Vector2<double> a_, rs::Vector2<double> b_, sf::Color c_) {
+            const double len = std::max(std::abs(b_.x - a_.x), std::abs(b_.y - a_.y));
+            const unsigned int n = std::max(1.0, ceil(len));
+            for (unsigned int i = 0; i <= n; i++) {
+                const double t = double(i)/n;
+                blend(lround(a_.x + (b_.x - a_.x)*t), lround(a_.y + (b_.y - a_.y)*t), c_);
+            }
+        }
+        /**
+         * \brief Draw a filled circle sector
+         * \param centre_ Tip of the sector
+         * \param rotation_ Direction of the sector's middle
+         * \param width_ Angle the sector spans
+         * \param r_ Radius
+        */
+        void sector(rs::Vector2<double> centre_, double rotation_, double width_, double r_, sf::Color c_) {
+            rs::Vector2<double> axis;
+            axis.from_bearing(1.0, rotation_);
+            const double min_cos = cos(width_/2);
+            for (int y = floor(centre_.y - r_); y <= ceil(centre_.y + r_); y++) {
+                for (int x = floor(centre_.x - r_); x <= ceil(centre_.x + r_); x++) {
+                    const double dx = x - centre_.x;
+                    const double dy = y - centre_.y;
+                    const double d2 = dx*dx + dy*dy;
+                    if (d2 > r_*r_) {continue;}
+                    // Compare cosines rather than angles to avoid atan2
+                    const double along = dx*axis.x + dy*axis.y;
+                    if (d2 == 0.0 or along >= min_cos*sqrt(d2)) {blend(x, y, c_);}
+                }
+            }
+        }
+    };
+    /**
+     * \brief Draws snapshots into frames in software, for rendering
+     * episodes without a display
+    */
+    class Renderer {
+        private:
+        Frame _background;
+
+        public:
+        /**
+         * \brief Draws the stage's collision areas once, to be copied into each frame
+         * \param stage_ The stage the bots are on
+        */
+        Renderer(const stage::Stage& stage_) {
+            auto win = stage_.window_size();
+            _background = Frame(win.x, win.y, sf::Color::White);
+            std::vector<double> xs(win.x);
+            std::vector<double> ys(win.x);
+            std::vector<std::uint64_t> mask;
+            for (unsigned int x = 0; x < win.x; x++) {xs[x] = x;}
+            for (unsigned int y = 0; y < win.y; y++) {
+                std::fill(ys.begin(), ys.end(), y);
+                stage_.collision(rs::Span<const double>(xs.data(), win.x), rs::Span<const double>(ys.data(), win.x), mask);
+                for (unsigned int x = 0; x < win.x; x++) {
+                    if ((mask[x/64] >> (x%64)) & 1) {_background.blend(x, y, sf::Color(255,0,0,255));}
+                }
+            }
+        }
+        /**
+         * \brief Draw the stage, then each bot's path, sonar field of view and body
+         * \param snapshot_ What to draw
+         * \param frame_ Replaced with the drawing
+        */
+        void render(const Snapshot& snapshot_, Frame& frame_) const {
+            frame_ = _background;
+            for (const BotState& b : snapshot_.bots) {
+                for (unsigned int i = 1; i < b.path.size(); i++) {
+                    frame_.line(b.path[i-1], b.path[i], sf::Color(0,255,255,255));
+                }
+            }
+            for (const BotState& b : snapshot_.bots) {
+                frame_.sector(b.pose.position, b.pose.rotation, b.fov, b.range, sf::Color(255,255,0,100));
+                rs::Vector2<double> beam;
+                beam.from_bearing(b.reading, b.sonar.rotation);
+                frame_.line(b.sonar.position, rs::Vector2<double>(b.sonar.position.x + beam.x, b.sonar.position.y + beam.y), sf::Color(255,140,0,255));
+                frame_.disc(b.pose.position, 8.0, b.active ? sf::Color(40,40,40,255) : sf::Color(120,120,120,255));
+                rs::Vector2<double> nose;
+                nose.from_bearing(8.0, b.pose.rotation);
+                frame_.line(b.pose.position, rs::Vector2<double>(b.pose.position.x + nose.x, b.pose.position.y + nose.y), sf::Color::White);
+            }
+        }
+    };
+    /**
+     * \brief Writes frames on a pool of threads. Either as numbered PNG
+     * files, or as one raw video file: the magic `PCMPRAWV`, then the
+     * width, height and frame count as 32 bit integers, then each frame's
+     * RGBA pixels
+    */
+    class FrameWriter {
+        public:
+        enum Format {
+            PNG_SEQUENCE,
+            RAW
+        };
+
+        private:
+        std::string _path;
+        Format _format;
+        std::FILE* _raw = nullptr;
+        Frame _first; // Size of the raw video
+
+        std::deque<std::pair<unsigned int, Frame>> _queue;
+        std::mutex _mutex;
+        std::condition_variable _changed;
+        std::vector<std::thread> _threads;
+        unsigned int _capacity;
+        unsigned int _pushed = 0;
+        bool _closing = false;
+        bool _failed = false;
+
+        void work() {
+            while (true) {
+                std::pair<unsigned int, Frame> job;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _changed.wait(lock, [this] {return _closing or !_queue.empty();});
+                    if (_queue.empty()) {return;}
+                    job = std::move(_queue.front());
+                    _queue.pop_front();
+                }
+                _changed.notify_all();
+                bool ok = true;
+                switch (_format)
+                {
+                case PNG_SEQUENCE: {
+                    char number[16];
+                    std::snprintf(number, sizeof(number), "_%06u.png", job.first);
+                    sf::Image image;
+                    image.create(job.second.width, job.second.height, job.second.pixels.data());
+                    ok = image.saveToFile(_path + number);
+                    break;
+                }
+                case RAW:
+                    // A single worker, so frames arrive in order
+                    ok = std::fwrite(job.second.pixels.data(), 1, job.second.pixels.size(), _raw) == job.second.pixels.size();
+                    break;
+                default:
+                    ok = false;
+                    break;
+                }
+                if (!ok) {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _failed = true;
+                }
+            }
+        }
+
+        void write_header(std::uint32_t width_, std::uint32_t height_, std::uint32_t count_) {
+            std::fseek(_raw, 0, SEEK_SET);
+            std::uint32_t fields[3] = {width_, height_, count_};
+            std::fwrite("PCMPRAWV", 1, 8, _raw);
+            std::fwrite(fields, sizeof(fields[0]), 3, _raw);
+            std::fseek(_raw, 0, SEEK_END);
+        }
+
+        public:
+        /**
+         * \param path_ Prefix of each PNG file, or the raw video file
+         * \param format_ How to write frames
+         * \param threads_ Encoder threads, `0` for one per core. Raw video always uses one
+        */
+        FrameWriter(const std::string& path_, Format format_, unsigned int threads_ = 0) : _path(path_), _format(format_) {
+            if (threads_ == 0) {threads_ = std::max(1u, std::thread::hardware_concurrency());}
+            if (_format == RAW) {
+                threads_ = 1;
+                _raw = std::fopen(path_.c_str(), "wb");
+                if (_raw == nullptr) {throw std::runtime_error("Unable to write video file");}
+            }
+            _capacity = threads_*2;
+            for (unsigned int t = 0; t < threads_; t++) {_threads.emplace_back(&FrameWriter::work, this);}
+        }
+        FrameWriter(const FrameWriter&) = delete;
+        FrameWriter& operator=(const FrameWriter&) = delete;
+        ~FrameWriter() {
+            try {finish();}
+            catch (...) {}
+        }
+        /**
+         * \brief Queue a frame to be written. Waits if the encoders are
+         * too far behind, so memory use stays bounded
+         * \param frame_ The frame. Raw video frames must all be the same size
+        */
+        void push(Frame frame_) {
+            {
+                // The encoders have stopped, so the frame could never be written
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (_closing) {throw std::logic_error("Frame pushed after FrameWriter::finish()");}
+            }
+            if (_format == RAW) {
+                if (_pushed == 0) {write_header(frame_.width, frame_.height, 0);}
+                else if (frame_.width != _first.width or frame_.height != _first.height) {
+                    throw std::runtime_error("Raw video frames must all be the same size");
+                }
+                _first.width = frame_.width;
+                _first.height = frame_.height;
+            }
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _changed.wait(lock, [this] {return _queue.size() < _capacity;});
+                _queue.emplace_back(_pushed++, std::move(frame_));
+            }
+            _changed.notify_all();
+        }
+        /**
+         * \brief Wait for every queued frame to be written.
+         * No frames can be pushed afterwards
+        */
+        void finish() {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _closing = true;
+            }
+            _changed.notify_all();
+            for (auto& t : _threads) {
+                if (t.joinable()) {t.join();}
+            }
+            if (_raw != nullptr) {
+                write_header(_first.width, _first.height, _pushed);
+                std::fclose(_raw);
+                _raw = nullptr;
+            }
+            if (_failed) {throw std::runtime_error("Unable to write frame(s)");}
+        }
+        /**
+         * \return The number of frames pushed
+        */
+        unsigned int frames() const {return _pushed;}
+    };
+    /**
+     * \brief Run a bot and render its episode without a display. Nothing
+     * waits on real time, so episodes render as fast as frames encode
+     * \param bot_ The bot, already placed on its stage
+     * \param renderer_ Renderer for the bot's stage
+     * \param writer_ Where frames are sent
+     * \param max_steps_ Most steps to run
+     * \param every_ Steps between frames
+     * \return The number of steps run
+    */
+    unsigned long long render_episode(bot::Bot& bot_, const Renderer& renderer_, FrameWriter& writer_, unsigned long long max_steps_, unsigned int every_) {
+        every_ = std::max(every_, 1u);
+        Snapshot snapshot;
+        snapshot.bots.resize(1);
+        BotState& state = snapshot.bots[0];
+        auto capture = [&] () {
+            const bot::Sonar& sonar = bot_.get_sonar();
+            state.pose = bot_.get_position();
+            state.sonar = sonar.position();
+            state.reading = sonar.latest().distance;
+            state.fov = sonar.fov();
+            state.range = sonar.range();
+            state.active = !bot_.collided() and bot_.in_bounds();
+            auto pos = state.pose.position;
+            if (state.path.empty() or std::abs(state.path.back().x - pos.x) + std::abs(state.path.back().y - pos.y) >= 1.0) {
+                state.path.push_back(rs::Vector2<float>(pos.x, pos.y));
+            }
+        };
+        capture();
+        Frame frame;
+        renderer_.render(snapshot, frame);
+        writer_.push(std::move(frame));
+        unsigned long long steps = 0;
+        while (steps < max_steps_ and state.active) {
+            bot_.step();
+            steps++;
+            snapshot.step = steps;
+            snapshot.time += bot_.get_sonar().gap();
+            capture();
+            if (steps % every_ == 0 or !state.active or steps == max_steps_) {
+                renderer_.render(snapshot, frame);
+                writer_.push(std::move(frame));
+            }
+        }
+        return steps;
+    }
+
+    /**
+     * \brief Layout of trajectory files written by `view::Recorder`.
+     * A header, then one record per step, then an index of keyframe
+     * offsets and a trailer. Each record is a flags byte, the pose (absolute
+     * in keyframes, otherwise the change from the previous step), the
+     * sonar's angle and reading, then the network outputs if there are any
+    */
+    namespace trajectory {
+        const char magic[8] = {'P','C','M','P','T','R','A','J'};
+        const char end_magic[8] = {'P','C','M','P','T','E','N','D'};
+        const std::uint32_t version = 1;
+        const std::size_t header_size = 48;
+        const std::size_t trailer_size = 24;
+
+        const double position_scale = 64.0; // Units per pixel
+        const double angle_scale = 65536.0/(2*pi); // Units per radian
+
+        // Record flags, the lowest two bits hold the move type
+        const std::uint8_t has_outputs = 4;
+        const std::uint8_t keyframe = 8;
+        const std::uint8_t active = 16;
+
+        std::uint16_t angle(double a_) {return static_cast<std::uint16_t>(std::lround(radians::wrap(a_)*angle_scale));}
+    }
+    /**
+     * \brief Writes an episode to a compact binary file as it is run, so
+     * it can be replayed with `view::Replay` without re-simulating.
+     * Poses are quantised to 1/64 px and 1/65536 of a turn, and most steps
+     * take 11 bytes plus the network outputs when a move is decided
+    */
+    class Recorder {
+        private:
+        std::ofstream _file;
+        std::vector<char> _record; // Reused for each record
+        std::vector<std::uint64_t> _index; // Offset of each keyframe
+        std::uint64_t _offset = 0;
+        unsigned long long _records = 0;
+        unsigned int _interval;
+        unsigned int _output_count;
+        double _range;
+        unsigned long long _decisions = 0;
+        bool _finished = false;
+
+        // Quantised pose of the previous record
+        std::int32_t _x = 0;
+        std::int32_t _y = 0;
+        std::uint16_t _rotation = 0;
+
+        template <typename T>
+        void put(T value_) {
+            const char* bytes = reinterpret_cast<const char*>(&value_);
+            _record.insert(_record.end(), bytes, bytes + sizeof(T));
+        }
+        void write(const char* data_, std::size_t size_) {
+            _file.write(data_, size_);
+            _offset += size_;
+        }
+
+        public:
+        /**
+         * \brief Write the header and the bot's current state
+         * \param path_ File to write
+         * \param bot_ The bot to record, already placed on its stage
+         * \param keyframe_interval_ Steps between absolute poses, which
+         * `view::Replay::seek()` starts decoding from
+        */
+        Recorder(const std::string& path_, bot::Bot_wBrain& bot_, unsigned int keyframe_interval_ = 256) :
+            _file(path_, std::ofstream::binary),
+            _interval(std::max(keyframe_interval_, 1u)),
+            _output_count(bot_.brain().shape().back()),
+            _range(bot_.get_sonar().range()),
+            _decisions(bot_.decisions())
+        {
+            if (!_file.good()) {throw std::runtime_error("Unable to write trajectory");}
+            const std::uint32_t fields[4] = {trajectory::version, bot_.stage().seed, _output_count, _interval};
+            const double sonar[3] = {_range, bot_.get_sonar().fov(), bot_.get_sonar().gap()};
+            write(trajectory::magic, sizeof(trajectory::magic));
+            write(reinterpret_cast<const char*>(fields), sizeof(fields));
+            write(reinterpret_cast<const char*>(sonar), sizeof(sonar));
+            record(bot_);
+        }
+        Recorder(const Recorder&) = delete;
+        Recorder& operator=(const Recorder&) = delete;
+        ~Recorder() {
+            if (!_finished) {
+                try {finish();}
+                catch (const std::exception&) {}
+            }
+        }
+        /**
+         * \brief Record the bot's state. Call after every step
+         * \param bot_ The bot given to the constructor
+        */
+        void record(const bot::Bot_wBrain& bot_) {
+            if (_finished) {throw std::runtime_error("Trajectory already finished");}
+            const rs::Position pose = bot_.get_position();
+            const bot::Sonar& sonar = bot_.get_sonar();
+            const std::int32_t x = static_cast<std::int32_t>(std::lround(pose.position.x*trajectory::position_scale));
+            const std::int32_t y = static_cast<std::int32_t>(std::lround(pose.position.y*trajectory::position_scale));
+            const std::uint16_t rotation = trajectory::angle(pose.rotation);
+            const std::int64_t dx = std::int64_t(x) - _x;
+            const std::int64_t dy = std::int64_t(y) - _y;
+
+            // Deltas that do not fit (the bot was moved) start a new keyframe
+            const bool key = _records % _interval == 0 or dx < INT16_MIN or dx > INT16_MAX or dy < INT16_MIN or dy > INT16_MAX;
+            const bool outputs = (key or bot_.decisions() != _decisions) and bot_.outputs().size() == _output_count;
+            _decisions = bot_.decisions();
+
+            std::uint8_t flags = static_cast<std::uint8_t>(bot_.get_move()) & 3;
+            if (outputs) {flags |= trajectory::has_outputs;}
+            if (key) {flags |= trajectory::keyframe;}
+            if (!bot_.collided() and bot_.in_bounds()) {flags |= trajectory::active;}
+
+            _record.clear();
+            put(flags);
+            if (key) {
+                // Only the regular keyframes are indexed, others are decoded through
+                if (_records % _interval == 0) {_index.push_back(_offset);}
+                put(x);
+                put(y);
+                put(rotation);
+            }
+            else {
+                put(static_cast<std::int16_t>(dx));
+                put(static_cast<std::int16_t>(dy));
+                put(static_cast<std::uint16_t>(rotation - _rotation));
+            }
+            put(trajectory::angle(sonar.position().rotation - pose.rotation));
+            put(static_cast<std::uint16_t>(std::lround(std::clamp(sonar.latest().distance/_range, 0.0, 1.0)*65535)));
+            if (outputs) {
+                for (double o : bot_.outputs()) {put(static_cast<float>(o));}
+            }
+            write(_record.data(), _record.size());
+            _x = x;
+            _y = y;
+            _rotation = rotation;
+            _records++;
+        }
+        /**
+         * \brief Write the index and close the file. Called by the destructor
+         * if it has not been called already
+        */
+        void finish() {
+            if (_finished) {return;}
+            _finished = true;
+            const std::uint64_t index_offset = _offset;
+            const std::uint64_t records = _records;
+            write(reinterpret_cast<const char*>(_index.data()), _index.size()*sizeof(std::uint64_t));
+            write(reinterpret_cast<const char*>(&records), sizeof(records));
+            write(reinterpret_cast<const char*>(&index_offset), sizeof(index_offset));
+            write(trajectory::end_magic, sizeof(trajectory::end_magic));
+            _file.close();
+            if (_file.fail()) {throw std::runtime_error("Unable to write trajectory");}
+        }
+        /**
+         * \return The number of steps recorded, including the starting state
+        */
+        unsigned long long records() const {return _records;}
+        /**
+         * \return The size of the file so far in bytes
+        */
+        std::uint64_t bytes() const {return _offset;}
+    };
+    /**
+     * \brief Run a bot and record its episode. See `view::Recorder`
+     * \param bot_ The bot, already placed on its stage
+     * \param path_ File to write
+     * \param max_steps_ Most steps to run
+     * \param keyframe_interval_ Steps between absolute poses
+     * \return The number of steps run
+    */
+    unsigned long long record_episode(bot::Bot_wBrain& bot_, const std::string& path_, unsigned long long max_steps_, unsigned int keyframe_interval_ = 256) {
+        Recorder recorder(path_, bot_, keyframe_interval_);
+        unsigned long long steps = 0;
+        while (steps < max_steps_ and !bot_.collided() and bot_.in_bounds()) {
+            bot_.step();
+            steps++;
+            recorder.record(bot_);
+        }
+        recorder.finish();
+        return steps;
+    }
+    /**
+     * \brief Plays back a file written by `view::Recorder`.
+     * The file is memory-mapped and decoded in place, so opening and
+     * seeking only touch the records that are needed
+    */
+    class Replay {
+        private:
+        // The decoded state at one step, and where the next record starts
+        struct Cursor {
+            unsigned long long step = 0;
+            std::size_t next = 0;
+            std::uint8_t flags = 0;
+            std::int32_t x = 0;
+            std::int32_t y = 0;
+            std::uint16_t rotation = 0;
+            std::uint16_t sonar = 0;
+            std::uint16_t reading = 0;
+            const char* outputs = nullptr; // Latest outputs, within the mapped file
+        };
+
+        rs::MappedFile _file;
+        unsigned int _seed = 0;
+        unsigned int _output_count = 0;
+        unsigned int _interval = 1;
+        double _range = 0.0;
+        double _fov = 0.0;
+        double _gap = 0.0;
+        unsigned long long _records = 0;
+        const char* _index = nullptr;
+        std::size_t _index_offset = 0;
+
+        Cursor _at; // Current step
+        Cursor _trace; // Last step added to `_path`
+        std::vector<rs::Vector2<float>> _path;
+        std::vector<unsigned long long> _path_steps; // Step of each path point
+
+        template <typename T>
+        T take(std::size_t& at_) const {
+            T value;
+            std::memcpy(&value, _file.data() + at_, sizeof(T));
+            at_ += sizeof(T);
+            return value;
+        }
+        // Decodes the record at `cursor_.next` as the given step
+        void decode(Cursor& cursor_, unsigned long long step_) const {
+            std::size_t at = cursor_.next;
+            if (at + 1 > _index_offset) {throw std::runtime_error("Trajectory is corrupt");}
+            const std::uint8_t flags = _file.data()[at];
+            const std::size_t size = 1 + ((flags & trajectory::keyframe) ? 10 : 6) + 4
+                                   + ((flags & trajectory::has_outputs) ? _output_count*sizeof(float) : 0);
+            if (at + size > _index_offset) {throw std::runtime_error("Trajectory is corrupt");}
+            at++;
+            if (flags & trajectory::keyframe) {
+                cursor_.x = take<std::int32_t>(at);
+                cursor_.y = take<std::int32_t>(at);
+                cursor_.rotation = take<std::uint16_t>(at);
+            }
+            else {
+                cursor_.x += take<std::int16_t>(at);
+                cursor_.y += take<std::int16_t>(at);
+                cursor_.rotation += take<std::uint16_t>(at);
+            }
+            cursor_.sonar = take<std::uint16_t>(at);
+            cursor_.reading = take<std::uint16_t>(at);
+            if (flags & trajectory::has_outputs) {cursor_.outputs = _file.data() + at;}
+            cursor_.flags = flags;
+            cursor_.step = step_;
+            cursor_.next = at + ((flags & trajectory::has_outputs) ? _output_count*sizeof(float) : 0);
+        }
+        rs::Vector2<float> point(const Cursor& cursor_) const {
+            return rs::Vector2<float>(cursor_.x/trajectory::position_scale, cursor_.y/trajectory::position_scale);
+        }
+
+        public:
+        Replay() {}
+        /**
+         * \param path_ File written by `view::Recorder`
+        */
+        Replay(const std::string& path_) {open(path_);}
+        /**
+         * \brief Map a trajectory file and go to its first step
+         * \param path_ File written by `view::Recorder`
+        */
+        void open(const std::string& path_) {
+            _path.clear();
+            _path_steps.clear();
+            if (!_file.open(path_)) {throw std::runtime_error("Unable to map trajectory");}
+            const char* bytes = _file.data();
+            const std::size_t size = _file.size();
+            if (size < trajectory::header_size + trajectory::trailer_size or std::memcmp(bytes, trajectory::magic, sizeof(trajectory::magic)) != 0
+                or std::memcmp(bytes + size - sizeof(trajectory::end_magic), trajectory::end_magic, sizeof(trajectory::end_magic)) != 0) {
+                _file.close();
+                throw std::runtime_error("Not a complete trajectory");
+            }
+            std::uint32_t fields[4];
+            double sonar[3];
+            std::memcpy(fields, bytes + sizeof(trajectory::magic), sizeof(fields));
+            std::memcpy(sonar, bytes + sizeof(trajectory::magic) + sizeof(fields), sizeof(sonar));
+            std::uint64_t trailer[2];
+            std::memcpy(trailer, bytes + size - trajectory::trailer_size, sizeof(trailer));
+            _seed = fields[1];
+            _output_count = fields[2];
+            _interval = std::max(fields[3], 1u);
+            _range = sonar[0];
+            _fov = sonar[1];
+            _gap = sonar[2];
+            _records = trailer[0];
+            _index_offset = trailer[1];
+            const std::uint64_t keyframes = (_records + _interval - 1)/_interval;
+            if (fields[0] != trajectory::version or _records == 0 or _index_offset < trajectory::header_size
+                or _index_offset + keyframes*sizeof(std::uint64_t) + trajectory::trailer_size != size) {
+                _file.close();
+                throw std::runtime_error("Trajectory is corrupt");
+            }
+            _index = bytes + _index_offset;
+
+            _at = Cursor();
+            _at.next = trajectory::header_size;
+            decode(_at, 0);
+            _trace = _at;
+            _path.push_back(point(_at));
+            _path_steps.push_back(0);
+        }
+        /**
+         * \brief Go to any step, decoding from the keyframe before it
+         * \param step_ Step to go to
+         * \return `false` if the step was not recorded
+        */
+        bool seek(unsigned long long step_) {
+            if (step_ >= _records) {return false;}
+            if (step_ < _at.step or step_/_interval != _at.step/_interval) {
+                const unsigned long long key = step_/_interval;
+                std::uint64_t offset;
+                std::memcpy(&offset, _index + key*sizeof(std::uint64_t), sizeof(offset));
+                _at.next = offset;
+                _at.outputs = nullptr; // Keyframes hold the outputs if there are any
+                decode(_at, key*_interval);
+            }
+            while (_at.step < step_) {decode(_at, _at.step + 1);}
+            return true;
+        }
+        /**
+         * \brief Go to the next step
+         * \return `false` at the end of the recording
+        */
+        bool next() {
+            if (_at.step + 1 >= _records) {return false;}
+            decode(_at, _at.step + 1);
+            return true;
+        }
+        /**
+         * \brief Fill a snapshot with the current step, for `view::draw()`
+         * or `view::Renderer`. The path is extended from where it was last
+         * drawn to, so playing forwards only decodes each record twice
+         * \param snapshot_ Snapshot to fill
+        */
+        void snapshot(Snapshot& snapshot_) {
+            if (_at.step < _trace.step) {
+                while (_path_steps.size() > 1 and _path_steps.back() > _at.step) {
+                    _path.pop_back();
+                    _path_steps.pop_back();
+                }
+                _trace = _at;
+            }
+            while (_trace.step < _at.step) {
+                decode(_trace, _trace.step + 1);
+                const rs::Vector2<float> p = point(_trace);
+                if (std::abs(_path.back().x - p.x) + std::abs(_path.back().y - p.y) >= 1.0) {
+                    _path.push_back(p);
+                    _path_steps.push_back(_trace.step);
+                }
+            }
+            snapshot_.step = _at.step;
+            snapshot_.time = _at.step*_gap;
+            snapshot_.bots.resize(1);
+            BotState& state = snapshot_.bots[0];
+            state.pose = pose();
+            state.sonar = sonar();
+            state.reading = reading();
+            state.fov = _fov;
+            state.range = _range;
+            state.active = active();
+            state.path = _path;
+        }
+        /**
+         * \return The current step
+        */
+        unsigned long long step() const {return _at.step;}
+        /**
+         * \return The number of steps recorded, including the starting state
+        */
+        unsigned long long records() const {return _records;}
+        /**
+         * \return The seed of the stage the episode was run on
+        */
+        unsigned int seed() const {return _seed;}
+        /**
+         * \return The time in seconds between steps
+        */
+        double gap() const {return _gap;}
+        /**
+         * \return The bot's position and rotation
+        */
+        rs::Position pose() const {
+            return rs::Position(_at.x/trajectory::position_scale, _at.y/trajectory::position_scale, _at.rotation/trajectory::angle_scale);
+        }
+        /**
+         * \return The sonar's position and rotation
+        */
+        rs::Position sonar() const {
+            rs::Position pos = pose();
+            pos.rotation += static_cast<std::int16_t>(_at.sonar)/trajectory::angle_scale;
+            return pos;
+        }
+        /**
+         * \return The latest sonar distance
+        */
+        double reading() const {return _at.reading*(_range/65535.0);}
+        /**
+         * \return The move the bot was making
+        */
+        bot::MoveType move() const {return static_cast<bot::MoveType>(_at.flags & 3);}
+        /**
+         * \return `false` once the bot had collided or left the stage
+        */
+        bool active() const {return _at.flags & trajectory::active;}
+        /**
+         * \return The number of network outputs
+        */
+        unsigned int output_count() const {return _output_count;}
+        /**
+         * \param i_ Output node
+         * \return The network's output from the latest decision, `0` before the first
+        */
+        double output(unsigned int i_) const {
+            if (_at.outputs == nullptr or i_ >= _output_count) {return 0.0;}
+            float value;
+            std::memcpy(&value, _at.outputs + i_*sizeof(float), sizeof(value));
+            return value;
+        }
+    };
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,240 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include "Assets.hpp"
+
+namespace text {
+    /**
+     * \brief A string laid out in one size of a font.
+     * Positions are relative to the top left of the text, as for `sf::Text`
+    */
+    struct Run {
+        std::vector<sf::Vertex> vertices; // Two triangles per glyph
+        sf::FloatRect bounds;
+    };
+    /**
+     * \brief Lays out each string once per size and keeps the result, so
+     * text that does not change costs nothing to lay out again
+    */
+    class Cache {
+        private:
+        struct Key {
+            std::string text;
+            unsigned int size;
+            bool operator==(const Key& other_) const {return size == other_.size and text == other_.text;}
+        };
+        struct Hash {
+            std::size_t operator()(const Key& key_) const {
+                return std::hash<std::string>()(key_.text) ^ (std::size_t(key_.size)*0x9E3779B97F4A7C15ull);
+            }
+        };
+
+        const sf::Font& _font;
+        std::unordered_map<Key, Run, Hash> _runs;
+        std::size_t _capacity = 4096; // Most runs kept before the cache is emptied
+
+        // Follows the layout of `sf::Text`
+        Run shape(const std::string& text_, unsigned int size_) const {
+            const float padding = 1.0f; // Glyphs are padded in the font texture
+            const float whitespace = _font.getGlyph(U' ', size_, false).advance;
+            const float line = _font.getLineSpacing(size_);
+            Run run;
+            run.vertices.reserve(text_.size()*6);
+            float x = 0.0f;
+            float y = static_cast<float>(size_);
+            float min_x = size_, min_y = size_, max_x = 0.0f, max_y = 0.0f;
+            sf::Uint32 previous = 0;
+            for (unsigned char c : text_) {
+                const sf::Uint32 current = c;
+                if (current == '\r') {continue;}
+                x += _font.getKerning(previous, current, size_);
+                previous = current;
+                if (current == ' ' or current == '\t' or current == '\n') {
+                    min_x = std::min(min_x, x);
+                    min_y = std::min(min_y, y);
+                    switch (current)
+                    {
+                    case ' ': x += whitespace; break;
+                    case '\t': x += whitespace*4; break;
+                    case '\n': y += line; x = 0.0f; break;
+                    default: break;
+                    }
+                    max_x = std::max(max_x, x);
+                    max_y = std::max(max_y, y);
+                    continue;
+                }
+                const sf::Glyph& glyph = _font.getGlyph(current, size_, false);
+                const float left = x + glyph.bounds.left - padding;
+                const float top = y + glyph.bounds.top - padding;
+                const float right = x + glyph.bounds.left + glyph.bounds.width + padding;
+                const float bottom = y + glyph.bounds.top + glyph.bounds.height + padding;
+                const float u1 = glyph.textureRect.left - padding;
+                const float v1 = glyph.textureRect.top - padding;
+                const float u2 = glyph.textureRect.left + glyph.textureRect.width + padding;
+                const float v2 = glyph.textureRect.top + glyph.textureRect.height + padding;
+                const sf::Color white = sf::Color::White;
+                run.vertices.push_back(sf::Vertex(sf::Vector2f(left, top), white, sf::Vector2f(u1, v1)));
+                run.vertices.push_back(sf::Vertex(sf::Vector2f(right, top), white, sf::Vector2f(u2, v1)));
+                run.vertices.push_back(sf::Vertex(sf::Vector2f(left, bottom), white, sf::Vector2f(u1, v2)));
+                run.vertices.push_back(sf::Vertex(sf::Vector2f(left, bottom), white, sf::Vector2f(u1, v2)));
+                run.vertices.push_back(sf::Vertex(sf::Vector2f(right, top), white, sf::Vector2f(u2, v1)));
+                run.vertices.push_back(sf::Vertex(sf::Vector2f(right, bottom), white, sf::Vector2f(u2, v2)));
+                min_x = std::min(min_x, x + glyph.bounds.left);
+                min_y = std::min(min_y, y + glyph.bounds.top);
+                max_x = std::max(max_x, x + glyph.bounds.left + glyph.bounds.width);
+                max_y = std::max(max_y, y + glyph.bounds.top + glyph.bounds.height);
+                x += glyph.advance;
+            }
+            if (max_x >= min_x) {run.bounds = sf::FloatRect(min_x, min_y, max_x - min_x, max_y - min_y);}
+            return run;
+        }
+
+        public:
+        /**
+         * \param font_ Font to lay text out in, which must outlive the cache
+        */
+        Cache(const sf::Font& font_) : _font(font_) {}
+        /**
+         * \brief Lay a string out, or find it if it has been laid out before.
+         * The run stays valid until the cache is next emptied, which only
+         * happens in `get()` once the capacity is reached
+         * \param text_ Text to lay out
+         * \param size_ Character size in pixels
+         * \return The laid out text
+        */
+        const Run& get(const std::string& text_, unsigned int size_) {
+            Key key{text_, size_};
+            auto found = _runs.find(key);
+            if (found != _runs.end()) {return found->second;}
+            if (_runs.size() >= _capacity) {_runs.clear();}
+            Run run = shape(text_, size_);
+            return _runs.emplace(std::move(key), std::move(run)).first->second;
+        }
+        /**
+         * \param size_ Character size in pixels
+         * \return The texture holding the font's glyphs at that size
+        */
+        const sf::Texture& texture(unsigned int size_) const {return _font.getTexture(size_);}
+        /**
+         * \brief Set the most runs kept. Defaults to `4096`
+         * \param capacity_
+        */
+        void set_capacity(std::size_t capacity_) {_capacity = std::max<std::size_t>(capacity_, 1);}
+        /**
+         * \return The number of runs held
+        */
+        std::size_t size() const {return _runs.size();}
+    };
+    /**
+     * \return The cache for `assets::fonts::arial`, shared by every widget
+    */
+    Cache& shared() {
+        static Cache cache(assets::fonts::arial);
+        return cache;
+    }
+    /**
+     * \brief Text in one size, drawn in a single draw call however many
+     * strings it holds. Separate batches are separate draw calls.
+     * The vertices are kept between frames, so text that is added again
+     * after `clear()` reuses the memory
+    */
+    class Batch : public sf::Drawable {
+        private:
+        Cache& _cache;
+        unsigned int _size;
+        std::vector<sf::Vertex> _vertices;
+
+        void draw(sf::RenderTarget& target_, sf::RenderStates states_) const override {
+            if (_vertices.empty()) {return;}
+            states_.texture = &_cache.texture(_size);
+            target_.draw(_vertices.data(), _vertices.size(), sf::Triangles, states_);
+        }
+
+        public:
+        /**
+         * \param size_ Character size in pixels
+         * \param cache_ Where laid out text is kept
+        */
+        Batch(unsigned int size_, Cache& cache_ = shared()) : _cache(cache_), _size(size_) {}
+        /**
+         * \brief Remove all the text
+        */
+        void clear() {_vertices.clear();}
+        /**
+         * \brief Add a string to the batch
+         * \param text_ Text to add
+         * \param position_ Top left of the text
+         * \param colour_ Colour of the text
+         * \return Bounds of the added text
+        */
+        sf::FloatRect add(const std::string& text_, sf::Vector2f position_, sf::Color colour_) {
+            const Run& run = _cache.get(text_, _size);
+            _vertices.reserve(_vertices.size() + run.vertices.size());
+            for (sf::Vertex v : run.vertices) {
+                v.position.x += position_.x;
+                v.position.y += position_.y;
+                v.color = colour_;
+                _vertices.push_back(v);
+            }
+            return sf::FloatRect(run.bounds.left + position_.x, run.bounds.top + position_.y, run.bounds.width, run.bounds.height);
+        }
+        /**
+         * \brief Add a string to the batch, cutting off any part outside a
+         * rectangle, as drawing it into a texture of that size would
+         * \param text_ Text to add
+         * \param position_ Top left of the text
+         * \param colour_ Colour of the text
+         * \param clip_ Area the text is kept inside
+         * \return Bounds of the added text, before clipping
+        */
+        sf::FloatRect add(const std::string& text_, sf::Vector2f position_, sf::Color colour_, sf::FloatRect clip_) {
+            const Run& run = _cache.get(text_, _size);
+            const float clip_right = clip_.left + clip_.width;
+            const float clip_bottom = clip_.top + clip_.height;
+            for (std::size_t q = 0; q + 6 <= run.vertices.size(); q += 6) {
+                // Each glyph is an axis aligned quad, see `Cache::shape()`
+                const sf::Vertex& first = run.vertices[q];
+                const sf::Vertex& last = run.vertices[q + 5];
+                const float left = first.position.x + position_.x;
+                const float top = first.position.y + position_.y;
+                const float right = last.position.x + position_.x;
+                const float bottom = last.position.y + position_.y;
+                const float l = std::max(left, clip_.left);
+                const float t = std::max(top, clip_.top);
+                const float r = std::min(right, clip_right);
+                const float b = std::min(bottom, clip_bottom);
+                if (l >= r or t >= b) {continue;}
+                // Texture coordinates are cut in proportion
+                const float du = (last.texCoords.x - first.texCoords.x)/(right - left);
+                const float dv = (last.texCoords.y - first.texCoords.y)/(bottom - top);
+                const float u1 = first.texCoords.x + (l - left)*du;
+                const float v1 = first.texCoords.y + (t - top)*dv;
+                const float u2 = first.texCoords.x + (r - left)*du;
+                const float v2 = first.texCoords.y + (b - top)*dv;
+                _vertices.push_back(sf::Vertex(sf::Vector2f(l, t), colour_, sf::Vector2f(u1, v1)));
+                _vertices.push_back(sf::Vertex(sf::Vector2f(r, t), colour_, sf::Vector2f(u2, v1)));
+                _vertices.push_back(sf::Vertex(sf::Vector2f(l, b), colour_, sf::Vector2f(u1, v2)));
+                _vertices.push_back(sf::Vertex(sf::Vector2f(l, b), colour_, sf::Vector2f(u1, v2)));
+                _vertices.push_back(sf::Vertex(sf::Vector2f(r, t), colour_, sf::Vector2f(u2, v1)));
+                _vertices.push_back(sf::Vertex(sf::Vector2f(r, b), colour_, sf::Vector2f(u2, v2)));
+            }
+            return sf::FloatRect(run.bounds.left + position_.x, run.bounds.top + position_.y, run.bounds.width, run.bounds.height);
+        }
+        /**
+         * \return Character size in pixels
+        */
+        unsigned int size() const {return _size;}
+        /**
+         * \return `true` if the batch holds no text
+        */
+        bool empty() const {return _vertices.empty();}
+    };
+}
+
+#endif
@@ -0,0 +1,10 @@
+#include "lib/Assets.hpp"
+
+int main() {
+    std::cout << "Program to pack the texture files into a single bundle" << std::endl;
+
+    assets::bundle::write(TEXTURES_PATH, BUNDLE_PATH);
+
+    std::cout << "Written to " << BUNDLE_PATH << std::endl;
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include "lib/Simulation.hpp"
+#include "lib/Interactables.hpp"
+
+int main() {
+    using namespace gui;
+
+    assets::load_assets();
+
+    // Create window
+    sf::RenderWindow window(sf::VideoMode(1000,1000), "Stage Tuner", sf::Style::Close);
+    // Create cell grid with the same size
+    CellGrid cell_grid(window.getSize().x, window.getSize().y, 32);
+
+    // Stage being tuned
+    stage::Stage stage(window.getSize().x, window.getSize().y);
+    stage.seed = 1;
+    stage.generate();
+    stage::StagePreview preview(stage);
+
+    // Define interactables
+    Slider<unsigned int> octaves(6, 1, 8, 2);
+    TextBox octaves_label(5);
+
+    Slider<double> frequency(6, 1.0, 16.0, 6.0);
+    TextBox frequency_label(5);
+
+    Slider<double> threshold(6, 0.3, 0.8, 0.55);
+    TextBox threshold_label(5);
+
+    // Set positions
+    octaves.setPosition(sf::Vector2f(160,32), cell_grid);
+    octaves_label.setPosition(sf::Vector2f(0,32));
+
+    frequency.setPosition(sf::Vector2f(160,64), cell_grid);
+    frequency_label.setPosition(sf::Vector2f(0,64));
+
+    threshold.setPosition(sf::Vector2f(160,96), cell_grid);
+    threshold_label.setPosition(sf::Vector2f(0,96));
+
+    // Settings the preview was last updated with
+    unsigned int shown_octaves = 0;
+    double shown_frequency = 0.0;
+    double shown_threshold = 0.0;
+
+    sf::Vector2i mouse_pos;
+    while (window.isOpen()) {
+        sf::Event event;
+        while (window.pollEvent(event)) {
+            switch (event.type) {
+                case sf::Event::Closed :
+                    window.close();
+                    goto exit_window;
+
+                case sf::Event::MouseMoved :
+                    // Clamp to avoid seg_fault
+                    mouse_pos = sf::Vector2i(std::clamp<int>(sf::Mouse::getPosition(window).x, 0, window.getSize().x), std::clamp<int>(sf::Mouse::getPosition(window).y, 0, window.getSize().y));
+                    break;
+                default: break;
+            }
+            cell_grid.handle(event, mouse_pos);
+        }
+
+        // Only changed settings restart the preview
+        if (octaves.value != shown_octaves or frequency.value != shown_frequency or threshold.value != shown_threshold) {
+            shown_octaves = octaves.value;
+            shown_frequency = frequency.value;
+            shown_threshold = threshold.value;
+            stage.set_octaves(shown_octaves);
+            stage.set_frequency(shown_frequency);
+            stage.set_threshold(shown_threshold);
+            preview.update();
+        }
+        preview.poll();
+
+        window.clear(sf::Color::White);
+        preview.draw(window);
+
+        octaves_label.set_text("Octaves: " + std::to_string(octaves.value));
+        frequency_label.set_text("Frequency: " + std::to_string(frequency.value).substr(0, 5));
+        threshold_label.set_text("Threshold: " + std::to_string(threshold.value).substr(0, 4));
+
+        // Render interactables
+        octaves.render();
+        frequency.render();
+        threshold.render();
+
+        // Draw sprites
+        window.draw(octaves_label);
+        window.draw(octaves);
+        window.draw(octaves.handle());
+
+        window.draw(frequency_label);
+        window.draw(frequency);
+        window.draw(frequency.handle());
+
+        window.draw(threshold_label);
+        window.draw(threshold);
+        window.draw(threshold.handle());
+
+        window.display();
+    }
+    exit_window:
+    return 0;
+}